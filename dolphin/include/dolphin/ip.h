@@ -2,6 +2,7 @@
 #define __DOLPHIN_OS_IP_H__
 
 #include <dolphin/ip/IFQueue.h>
+#include <dolphin/ip/IPTimer.h>
 #include <dolphin/ip/IP.h>
 #include <dolphin/ip/IPIgmp.h>
 #include <dolphin/ip/IPIcmp.h>
@@ -10,6 +11,14 @@
 #include <dolphin/ip/IPOpt.h>
 #include <dolphin/ip/IPFrag.h>
 #include <dolphin/ip/IPTcp.h>
+#include <dolphin/ip/IPTcpOpt.h>
+#include <dolphin/ip/IPTcpFastOpen.h>
+#include <dolphin/ip/IPTcpCC.h>
+#include <dolphin/ip/IPTcpPace.h>
+#include <dolphin/ip/IPTcpSack.h>
+#include <dolphin/ip/IPTcpRack.h>
+#include <dolphin/ip/IPTcpAck.h>
+#include <dolphin/ip/IPTcpPredict.h>
 #include <dolphin/ip/IPUdp.h>
 #include <dolphin/ip/IPSocket.h>
 #include <dolphin/ip/IFFifo.h>
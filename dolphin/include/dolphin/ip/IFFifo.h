@@ -31,6 +31,7 @@ u8* IFRingOut(u8* buf, s32 size, u8* head, s32 used, u8* data, s32 len);
 int IFRingGet(u8* buf, s32 size, u8* head, s32 used, IFVec* vec, s32 len);
 u8* IFRingPut(u8* buf, s32 size, u8* head, s32 used, s32 len);
 u8* IFRingInEx(u8* buf, s32 size, u8* head, s32 used, s32 offset, const u8* data, s32 * adv, IFBlock* blockTable, s32 maxblock);
+u8* IFRingInBlock(u8* buf, s32 size, u8* head, s32 used, s32 offset, const u8* data, s32* adv, IFBlock* blockTable, s32 maxblock);
 
 #ifdef __cplusplus
 }
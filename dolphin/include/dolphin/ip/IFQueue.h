@@ -183,7 +183,7 @@ do {                                                    \
 do {                                                    \
     register IFQueue* ___prev;                           \
                                                         \
-    ___prev = (queue)->next;                             \
+    ___prev = (queue)->prev;                             \
                                                         \
     if (___prev == 0) {                               \
         (queue)->next = (IFQueue*)(entry);              \
@@ -25,6 +25,14 @@ extern "C" {
 #define IP_PROTO_TCP  0x06
 #define IP_PROTO_UDP  0x11
 
+/* Segmentation offload. Drivers that split TCP datagrams larger than the
+ * MTU themselves register IF_OFFLOAD_TSO with IPSetOffload; for the other
+ * interfaces IPOut does it in software, using up to IP_SEG_NUM states at
+ * once. */
+#define IF_OFFLOAD_TSO 0x01
+#define IP_SEG_NUM 16
+#define IP_OFFLOAD_NUM 4
+
 typedef struct IPSocket {
     // total size: 0x8
     u8 len; // offset 0x0, size 0x1
@@ -72,6 +80,21 @@ typedef struct IFDatagram {
     IFVec vec[1]; // offset 0x34, size 0x8
 } IFDatagram;
 
+typedef struct IPSegState {
+    // total size: 0x14
+    IFDatagram* datagram; // offset 0x0, size 0x4
+    IPInterface* interface; // offset 0x4, size 0x4
+    s32 size; // offset 0x8, size 0x4
+    s32 left; // offset 0xC, size 0x4
+    s32 result; // offset 0x10, size 0x4
+} IPSegState;
+
+typedef struct IPOffload {
+    // total size: 0x8
+    IPInterface* interface; // offset 0x0, size 0x4
+    u32 flag; // offset 0x4, size 0x4
+} IPOffload;
+
 typedef struct IPInterfaceConf {
     // total size: 0x40
     IPInterface* interface; // offset 0x0, size 0x4
@@ -135,7 +158,11 @@ typedef struct IPHeader {
 } IPHeader;
 
 char* IPNtoA(const u8* addr);
+u32 IPHashTuple(const u8* local, u16 localPort, const u8* remote, u16 remotePort);
 void IFInitDatagram(IFDatagram* datagram, u16 type, int nVec);
+s32 IPOut(IFDatagram* datagram);
+s32 IPSetOffload(IPInterface* interface, u32 flag);
+u32 IPGetOffload(IPInterface* interface);
 
 #ifdef __cplusplus
 }
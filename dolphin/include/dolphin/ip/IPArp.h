@@ -3,6 +3,7 @@
 
 #include <dolphin/ip/IP.h>
 #include <dolphin/ip/IPEther.h>
+#include <dolphin/ip/IPTimer.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,17 +19,17 @@ extern "C" {
 #define ARP_CACHE_POLLING 3
 
 typedef struct ARPCache {
-    // total size: 0xA8
+    // total size: 0x98
     IFQueue link; // offset 0x0, size 0x8
-    OSAlarm alarm; // offset 0x8, size 0x28
-    int rxmit; // offset 0x30, size 0x4
-    int state; // offset 0x34, size 0x4
-    u8 hwAddr[6]; // offset 0x38, size 0x6
-    u8 prAddr[4]; // offset 0x3E, size 0x4
-    IPInterface* interface; // offset 0x44, size 0x4
-    IFDatagram datagram; // offset 0x48, size 0x3C
-    u8 arp[28]; // offset 0x84, size 0x1C
-    IFQueue queue; // offset 0xA0, size 0x8
+    IPTimer alarm; // offset 0x8, size 0x18
+    int rxmit; // offset 0x20, size 0x4
+    int state; // offset 0x24, size 0x4
+    u8 hwAddr[6]; // offset 0x28, size 0x6
+    u8 prAddr[4]; // offset 0x2E, size 0x4
+    IPInterface* interface; // offset 0x34, size 0x4
+    IFDatagram datagram; // offset 0x38, size 0x3C
+    u8 arp[28]; // offset 0x74, size 0x1C
+    IFQueue queue; // offset 0x90, size 0x8
 } ARPCache;
 
 typedef struct ARPHeader {
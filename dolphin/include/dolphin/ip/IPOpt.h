@@ -13,6 +13,10 @@ extern "C" {
 #define IP_OPT_MTTL 10
 #define IP_OPT_JOIN_MCAST 11
 #define IP_OPT_LEAVE_MCAST 12
+#define IP_OPT_REUSEPORT 13
+
+/* IPInfo.flag bit; the low bits hold the multicast group memberships */
+#define IP_FLAG_REUSEPORT 0x4000
 
 s32 IPProcessSourceRoute(IPHeader* ip);
 
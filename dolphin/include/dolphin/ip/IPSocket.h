@@ -101,6 +101,27 @@ typedef struct SOLinger {
     int linger; // offset 0x4, size 0x4
 } SOLinger;
 
+#define SO_POLLRDNORM 0x0001
+#define SO_POLLRDBAND 0x0002
+#define SO_POLLPRI 0x0004
+#define SO_POLLWRNORM 0x0008
+#define SO_POLLWRBAND 0x0010
+#define SO_POLLERR 0x0020
+#define SO_POLLHUP 0x0040
+#define SO_POLLNVAL 0x0080
+#define SO_POLLIN (SO_POLLRDNORM | SO_POLLRDBAND)
+#define SO_POLLOUT SO_POLLWRNORM
+
+#define SO_SNDBUF 0x1001
+#define SO_RCVBUF 0x1002
+#define SO_BUF_MIN 512
+#define SO_BUF_MAX (256 * 1024)
+#define SO_SHARD_MAX 4
+
+#define SO_EPOLL_CTL_ADD 1
+#define SO_EPOLL_CTL_DEL 2
+#define SO_EPOLL_CTL_MOD 3
+
 typedef struct SOPollFD {
     // total size: 0x8
     int fd; // offset 0x0, size 0x4
@@ -108,7 +129,55 @@ typedef struct SOPollFD {
     s16 revents; // offset 0x6, size 0x2
 } SOPollFD;
 
+typedef struct SOAsync SOAsync;
+typedef void (*SOAsyncCallback)(SOAsync*, int);
+
+typedef struct SOCompletionQueue {
+    // total size: 0x10
+    IFQueue queue; // offset 0x0, size 0x8
+    OSThreadQueue queueThread; // offset 0x8, size 0x8
+} SOCompletionQueue;
+
+struct SOAsync {
+    // total size: 0x38
+    IFLink link; // offset 0x0, size 0x8
+    int s; // offset 0x8, size 0x4
+    int shard; // offset 0xC, size 0x4
+    int result; // offset 0x10, size 0x4
+    SOAsyncCallback callback; // offset 0x14, size 0x4
+    SOCompletionQueue* queue; // offset 0x18, size 0x4
+    void* param; // offset 0x1C, size 0x4
+    void* buf; // offset 0x20, size 0x4
+    int len; // offset 0x24, size 0x4
+    SOSockAddrIn addr; // offset 0x28, size 0x8
+};
+
 s32 SOGetHostID();
+void SOSetMemoryLimit(u32 soft, u32 hard);
+int SOGetMemoryPressure(void);
+int SOSetShardNum(int num);
+int SOBindShard(int shard);
+int SOGetShard(int s);
+int SOSetBufferSize(int s, int optname, int size);
+int SOGetBufferSize(int s, int optname);
+void SOSetAutoTuneLimit(int socketMax, int totalMax);
+int SOSetCongestionControl(int s, int algorithm);
+int SOSetMaxPacingRate(int s, int rate);
+int SOSetAckPolicy(int s, int every);
+int SOSetFastOpen(int s, BOOL enable);
+int SOConnectData(int s, void* sockAddr, const void* buf, int len);
+int SOEpollCreate(void);
+int SOEpollClose(int ep);
+int SOEpollCtl(int ep, int op, int s, s16 events);
+int SOEpollWait(int ep, SOPollFD* fds, int nfds, OSTime timeout);
+void SOInitAsync(SOAsync* op, SOAsyncCallback callback, SOCompletionQueue* queue, void* param);
+void SOInitCompletionQueue(SOCompletionQueue* queue);
+SOAsync* SOGetCompletion(SOCompletionQueue* queue, BOOL block);
+int SOConnectAsync(int s, void* sockAddr, SOAsync* op);
+int SOAcceptAsync(int s, SOAsync* op);
+int SOSendAsync(int s, const void* buf, int len, SOAsync* op);
+int SORecvAsync(int s, void* buf, int len, SOAsync* op);
+int SOCloseAsync(int s, SOAsync* op);
 
 #ifdef __cplusplus
 }
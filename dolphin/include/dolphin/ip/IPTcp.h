@@ -3,12 +3,15 @@
 
 #include <dolphin/ip/IP.h>
 #include <dolphin/ip/IFFifo.h>
+#include <dolphin/ip/IPTimer.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define TCP_STATE_LISTEN 1
+#define TCP_STATE_SYN_RECEIVED 3
+#define TCP_STATE_ESTABLISHED 4
 
 #define TCP_FLAG_FIN (1 << 0)
 #define TCP_FLAG_SYN (1 << 1)
@@ -17,6 +20,20 @@ extern "C" {
 #define TCP_FLAG_ACK (1 << 4)
 #define TCP_FLAG_URG (1 << 5)
 
+#define TCP_SEQ_LT(a, b) ((s32)((a) - (b)) < 0)
+#define TCP_SEQ_LEQ(a, b) ((s32)((a) - (b)) <= 0)
+
+#define TCP_HLEN(tcp) (((tcp)->flag >> 10) & 0x3C)
+
+#define TCP_OPT_EOL 0
+#define TCP_OPT_NOP 1
+#define TCP_OPT_MSS 2
+#define TCP_OPT_WSCALE 3
+#define TCP_OPT_SACK_PERMITTED 4
+#define TCP_OPT_SACK 5
+#define TCP_OPT_TS 8
+#define TCP_OPT_FASTOPEN 34
+
 typedef struct TCPHeader {
     // total size: 0x14
     u16 src; // offset 0x0, size 0x2
@@ -38,10 +55,11 @@ typedef struct TCPSackHole {
 } TCPSackHole;
 
 typedef struct TCPInfo TCPInfo;
+typedef struct TCPCongestionOps TCPCongestionOps;
 typedef void (*TCPCallback)(TCPInfo*, s32);
 
 struct TCPInfo {
-    // total size: 0x360
+    // total size: 0x42C
     IPInfo pair; // offset 0x0, size 0x20
     OSThreadQueue queueThread; // offset 0x20, size 0x8
     IPInterface* interface; // offset 0x28, size 0x4
@@ -127,7 +145,8 @@ struct TCPInfo {
     TCPCallback openCallback; // offset 0x2FC, size 0x4
     s32* openResult; // offset 0x300, size 0x4
     int linger; // offset 0x304, size 0x4
-    OSAlarm lingerAlarm; // offset 0x308, size 0x28
+    IPTimer lingerAlarm; // offset 0x308, size 0x18
+    u8 lingerPad[0x10]; // offset 0x320, size 0x10
     int sendLowat; // offset 0x330, size 0x4
     int recvLowat; // offset 0x334, size 0x4
     TCPInfo* logging; // offset 0x338, size 0x4
@@ -136,6 +155,35 @@ struct TCPInfo {
     IFLink linkLog; // offset 0x34C, size 0x8
     s32 accepting; // offset 0x354, size 0x4
     void* node; // offset 0x358, size 0x4
+    const TCPCongestionOps* cc; // offset 0x35C, size 0x4
+    OSTime ccState[6]; // offset 0x360, size 0x30
+    OSTime paceNext; // offset 0x390, size 0x8
+    s32 paceMaxRate; // offset 0x398, size 0x4
+    BOOL paceQueued; // offset 0x39C, size 0x4
+    IFLink linkPace; // offset 0x3A0, size 0x8
+    IFQueue sackList; // offset 0x3A8, size 0x8
+    s32 sackBytes; // offset 0x3B0, size 0x4
+    s32 sackCount; // offset 0x3B4, size 0x4
+    IFQueue rackList; // offset 0x3B8, size 0x8
+    OSTime rackXmit; // offset 0x3C0, size 0x8
+    OSTime rackRtt; // offset 0x3C8, size 0x8
+    s32 rackEndSeq; // offset 0x3D0, size 0x4
+    s32 rackLost; // offset 0x3D4, size 0x4
+    s32 rackTimer; // offset 0x3D8, size 0x4
+    s32 tlpHighSeq; // offset 0x3DC, size 0x4
+    BOOL tlpPending; // offset 0x3E0, size 0x4
+    IPTimer rackAlarm; // offset 0x3E8, size 0x18
+    u8 sendScale; // offset 0x400, size 0x1
+    u8 recvScale; // offset 0x401, size 0x1
+    u16 optFlag; // offset 0x402, size 0x2
+    u32 tsRecent; // offset 0x404, size 0x4
+    OSTime tsRecentAge; // offset 0x408, size 0x8
+    s32 lastAckSent; // offset 0x410, size 0x4
+    s32 ackSegs; // offset 0x414, size 0x4
+    s32 ackQuick; // offset 0x418, size 0x4
+    s32 ackEvery; // offset 0x41C, size 0x4
+    OSTime ackLastRecv; // offset 0x420, size 0x8
+    s32 tfoLen; // offset 0x428, size 0x4
 };
 
 u16 TCPCheckSum(IFVec* vec, s32 nVec);
@@ -0,0 +1,30 @@
+#ifndef __DOLPHIN_OS_IP_TCPACK_H__
+#define __DOLPHIN_OS_IP_TCPACK_H__
+
+#include <dolphin/ip/IP.h>
+#include <dolphin/ip/IPTcp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default TCPInfo.ackEvery: ACK every second full-sized segment */
+#define TCP_ACK_EVERY 2
+#define TCP_ACK_EVERY_MAX 8
+
+/* Upper bound on the segments ACKed at once after connection start or idle */
+#define TCP_ACK_QUICK_MAX 16
+
+/* Idle time after which quick-ack mode is re-entered, used before rto is
+ * known */
+#define TCP_ACK_IDLE OSSecondsToTicks(1)
+
+void TCPAckInit(TCPInfo* tcp);
+BOOL TCPAckNow(TCPInfo* tcp, s32 len);
+void TCPAckSent(TCPInfo* tcp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef __DOLPHIN_OS_IP_TCPCC_H__
+#define __DOLPHIN_OS_IP_TCPCC_H__
+
+#include <dolphin/ip/IP.h>
+#include <dolphin/ip/IPTcp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TCP_CC_RENO 0
+#define TCP_CC_CUBIC 1
+#define TCP_CC_BBR 2
+#define TCP_CC_NUM 3
+
+struct TCPCongestionOps {
+    // total size: 0x18
+    const char* name; // offset 0x0, size 0x4
+    void (*init)(TCPInfo* tcp); // offset 0x4, size 0x4
+    void (*onAck)(TCPInfo* tcp, s32 acked); // offset 0x8, size 0x4
+    void (*onLoss)(TCPInfo* tcp); // offset 0xC, size 0x4
+    void (*onRto)(TCPInfo* tcp); // offset 0x10, size 0x4
+    s32 (*getPacingRate)(TCPInfo* tcp); // offset 0x14, size 0x4
+};
+
+extern const TCPCongestionOps TCPReno;
+extern const TCPCongestionOps TCPCubic;
+extern const TCPCongestionOps TCPBbr;
+extern const TCPCongestionOps* TCPCongestionTable[TCP_CC_NUM];
+
+s32 TCPSetCongestion(TCPInfo* tcp, const TCPCongestionOps* ops);
+void TCPCongestionInit(TCPInfo* tcp);
+void TCPCongestionAck(TCPInfo* tcp, s32 acked);
+void TCPCongestionLoss(TCPInfo* tcp);
+void TCPCongestionRto(TCPInfo* tcp);
+s32 TCPGetPacingRate(TCPInfo* tcp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
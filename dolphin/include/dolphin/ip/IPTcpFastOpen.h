@@ -0,0 +1,38 @@
+#ifndef __DOLPHIN_OS_IP_TCPFASTOPEN_H__
+#define __DOLPHIN_OS_IP_TCPFASTOPEN_H__
+
+#include <dolphin/ip/IP.h>
+#include <dolphin/ip/IPTcp.h>
+#include <dolphin/ip/IPTcpOpt.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TCP_FASTOPEN_CACHE_NUM 16
+#define TCP_FASTOPEN_COOKIE_LEN 8
+
+/* Largest option TCPFastOpenBuildOption writes, padding included */
+#define TCP_OPT_FASTOPEN_LEN (((2 + TCP_OPT_COOKIE_MAX) + 3) & ~3)
+
+typedef struct TCPFastOpenEntry {
+    // total size: 0x20
+    u8 addr[4]; // offset 0x0, size 0x4
+    u16 mss; // offset 0x4, size 0x2
+    u8 len; // offset 0x6, size 0x1
+    u8 cookie[TCP_OPT_COOKIE_MAX]; // offset 0x7, size 0x10
+    OSTime used; // offset 0x18, size 0x8
+} TCPFastOpenEntry;
+
+void TCPFastOpenInit(void);
+void TCPFastOpenMakeCookie(const u8* addr, u8* cookie);
+BOOL TCPFastOpenCheckCookie(const u8* addr, const TCPOptions* opt);
+s32 TCPFastOpenBuildOption(u8* opt, const u8* cookie, int len);
+s32 TCPFastOpenBuildSyn(TCPInfo* tcp, u8* opt);
+void TCPFastOpenSynAck(TCPInfo* tcp, const TCPHeader* th, const TCPOptions* opt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
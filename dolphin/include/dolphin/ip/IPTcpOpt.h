@@ -0,0 +1,57 @@
+#ifndef __DOLPHIN_OS_IP_TCPOPT_H__
+#define __DOLPHIN_OS_IP_TCPOPT_H__
+
+#include <dolphin/ip/IP.h>
+#include <dolphin/ip/IPTcp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// TCPInfo.optFlag, TCPOptions.flag
+#define TCP_OPT_FLAG_WSCALE 0x01
+#define TCP_OPT_FLAG_TS 0x02
+#define TCP_OPT_FLAG_SACK 0x04
+#define TCP_OPT_FLAG_MSS 0x08
+#define TCP_OPT_FLAG_TFO 0x10
+#define TCP_OPT_FLAG_NEGOTIATED 0x100 // TCPInfo.optFlag only
+
+#define TCP_WSCALE_MAX 14
+#define TCP_OPT_COOKIE_MAX 16
+
+/* Space TCPOptBuildSyn needs; TCPOptBuild needs TCP_OPT_TS_LEN */
+#define TCP_OPT_SYN_LEN 20
+#define TCP_OPT_TS_LEN 12
+
+/* TS.Recent is considered stale after this long without an update (PAWS) */
+#define TCP_PAWS_IDLE OSSecondsToTicks(24 * 24 * 60 * 60)
+
+typedef struct TCPOptions {
+    // total size: 0x20
+    u16 mss; // offset 0x0, size 0x2
+    u8 wscale; // offset 0x2, size 0x1
+    u8 flag; // offset 0x3, size 0x1
+    u32 tsVal; // offset 0x4, size 0x4
+    u32 tsEcr; // offset 0x8, size 0x4
+    u8 cookieLen; // offset 0xC, size 0x1
+    u8 cookie[TCP_OPT_COOKIE_MAX]; // offset 0xD, size 0x10
+} TCPOptions;
+
+void TCPOptInit(TCPInfo* tcp);
+void TCPOptParse(const TCPHeader* tcp, TCPOptions* opt);
+void TCPOptNegotiate(TCPInfo* tcp, const TCPOptions* opt);
+u8 TCPOptGetRecvScale(s32 size);
+s32 TCPOptBuildSyn(u8* opt, u16 mss, u16 flag, u8 recvScale, u32 tsEcr);
+s32 TCPOptBuild(TCPInfo* tcp, u8* opt);
+BOOL TCPOptPaws(TCPInfo* tcp, const TCPHeader* th, const TCPOptions* opt);
+OSTime TCPOptRttSample(TCPInfo* tcp, const TCPOptions* opt);
+s32 TCPOptGetSendWindow(TCPInfo* tcp, const TCPHeader* th);
+u16 TCPOptPutRecvWindow(TCPInfo* tcp, s32 win);
+s32 TCPOptGetMaxWindow(TCPInfo* tcp);
+u32 TCPOptGetTsVal(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
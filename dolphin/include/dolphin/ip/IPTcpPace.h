@@ -0,0 +1,29 @@
+#ifndef __DOLPHIN_OS_IP_TCPPACE_H__
+#define __DOLPHIN_OS_IP_TCPPACE_H__
+
+#include <dolphin/ip/IP.h>
+#include <dolphin/ip/IPTcp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Pacing gains in percent of cwnd/srtt, as in slow start and congestion
+ * avoidance */
+#define TCP_PACE_GAIN_SS 200
+#define TCP_PACE_GAIN_CA 120
+
+typedef void (*TCPPaceOutput)(TCPInfo*);
+
+void TCPPaceInit(void);
+void TCPPaceSetOutput(TCPPaceOutput output);
+s32 TCPGetPaceRate(TCPInfo* tcp);
+BOOL TCPPaceCheck(TCPInfo* tcp);
+void TCPPaceSent(TCPInfo* tcp, s32 len);
+void TCPPaceCancel(TCPInfo* tcp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
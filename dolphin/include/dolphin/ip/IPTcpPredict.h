@@ -0,0 +1,39 @@
+#ifndef __DOLPHIN_OS_IP_TCPPREDICT_H__
+#define __DOLPHIN_OS_IP_TCPPREDICT_H__
+
+#include <dolphin/ip/IP.h>
+#include <dolphin/ip/IPTcp.h>
+#include <dolphin/ip/IPTcpOpt.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// TCPPredictIn() result; TCP_PREDICT_NONE means take the slow path
+#define TCP_PREDICT_NONE 0x00
+#define TCP_PREDICT_ACKED 0x01
+#define TCP_PREDICT_DATA 0x02
+#define TCP_PREDICT_ACK_NOW 0x04
+#define TCP_PREDICT_PLACED 0x08
+
+typedef struct TCPPredictStat {
+    // total size: 0x18
+    u32 ackSegs; // offset 0x0, size 0x4
+    u32 dataSegs; // offset 0x4, size 0x4
+    u32 slowSegs; // offset 0x8, size 0x4
+    u32 fastTicks; // offset 0xC, size 0x4
+    u32 slowTicks; // offset 0x10, size 0x4
+    u32 placedBytes; // offset 0x14, size 0x4
+} TCPPredictStat;
+
+s32 TCPPredictIn(TCPInfo* tcp, const TCPHeader* th, const u8* data, s32 len, TCPOptions* opt);
+s32 TCPPredictPlace(TCPInfo* tcp, const u8* data, s32 len);
+void TCPPredictAccount(s32 result, OSTick start);
+void TCPPredictGetStat(TCPPredictStat* stat);
+void TCPPredictResetStat(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef __DOLPHIN_OS_IP_TCPRACK_H__
+#define __DOLPHIN_OS_IP_TCPRACK_H__
+
+#include <dolphin/ip/IP.h>
+#include <dolphin/ip/IPTcp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TCP_RACK_SEG_NUM 512
+
+// TCPRackSeg.flag
+#define TCP_RACK_RXMIT 0x01
+#define TCP_RACK_LOST 0x02
+#define TCP_RACK_SACKED 0x04
+
+// TCPInfo.rackTimer
+#define TCP_RACK_TIMER_NONE 0
+#define TCP_RACK_TIMER_REO 1
+#define TCP_RACK_TIMER_TLP 2
+
+/* Delayed ACK allowance added to the probe timeout when a single segment
+ * is in flight, and the probe timeout used before an RTT sample exists */
+#define TCP_RACK_DACK_MAX OSMillisecondsToTicks(200)
+#define TCP_RACK_PTO_INIT OSSecondsToTicks(1)
+
+typedef struct TCPRackSeg {
+    // total size: 0x20
+    IFLink link; // offset 0x0, size 0x8
+    s32 start; // offset 0x8, size 0x4
+    s32 end; // offset 0xC, size 0x4
+    OSTime xmit; // offset 0x10, size 0x8
+    u32 flag; // offset 0x18, size 0x4
+} TCPRackSeg;
+
+/* Called from the RACK timer in interrupt context. probe is FALSE when
+ * segments have been marked lost and should be retransmitted, TRUE when a
+ * tail loss probe is due. */
+typedef void (*TCPRackOutput)(TCPInfo* tcp, BOOL probe);
+
+void TCPRackInit(void);
+void TCPRackSetOutput(TCPRackOutput output);
+void TCPRackSent(TCPInfo* tcp, s32 seq, s32 len);
+s32 TCPRackAck(TCPInfo* tcp);
+void TCPRackRto(TCPInfo* tcp);
+BOOL TCPRackNextLost(TCPInfo* tcp, s32* start, s32* end);
+BOOL TCPRackProbeRange(TCPInfo* tcp, s32* start, s32* end);
+void TCPRackClear(TCPInfo* tcp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
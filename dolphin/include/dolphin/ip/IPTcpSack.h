@@ -0,0 +1,40 @@
+#ifndef __DOLPHIN_OS_IP_TCPSACK_H__
+#define __DOLPHIN_OS_IP_TCPSACK_H__
+
+#include <dolphin/ip/IP.h>
+#include <dolphin/ip/IPTcp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TCP_SACK_BLOCK_NUM 512
+#define TCP_SACK_DUPTHRESH 3
+
+/* Out-of-order blocks a receive ring can track, the length of TCPInfo.asb */
+#define TCP_SACK_ASB_NUM 4
+
+typedef struct TCPSackBlock {
+    // total size: 0x10
+    IFLink link; // offset 0x0, size 0x8
+    s32 start; // offset 0x8, size 0x4
+    s32 end; // offset 0xC, size 0x4
+} TCPSackBlock;
+
+void TCPSackInit(void);
+void TCPSackUpdate(TCPInfo* tcp, s32 start, s32 end);
+void TCPSackAdvance(TCPInfo* tcp);
+void TCPSackClear(TCPInfo* tcp);
+BOOL TCPSackNextHole(TCPInfo* tcp, s32 seq, s32* start, s32* end);
+BOOL TCPSackIsLost(TCPInfo* tcp, s32 seq);
+BOOL TCPSackIsSacked(TCPInfo* tcp, s32 seq);
+void TCPSackInitRecv(TCPInfo* tcp);
+BOOL TCPSackHasHoles(TCPInfo* tcp);
+s32 TCPSackQueue(TCPInfo* tcp, s32 seq, const u8* data, s32 len);
+s32 TCPSackBuildOption(TCPInfo* tcp, u8* opt, s32 len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
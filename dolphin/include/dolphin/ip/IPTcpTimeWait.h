@@ -7,8 +7,31 @@
 extern "C" {
 #endif
 
+/* 2 MSL */
+#define TCP_TIMEWAIT_TIME OSSecondsToTicks(60)
+
+#define TCP_TIMEWAIT_NIL 0xFFFF
+#define TCP_TIMEWAIT_NUM_MAX 0xFFFE
+
+typedef struct TCPTimeWaitEntry {
+    // total size: 0x14
+    u16 next; // offset 0x0, size 0x2
+    u16 srcPort; // offset 0x2, size 0x2
+    u16 dstPort; // offset 0x4, size 0x2
+    u16 bucket; // offset 0x6, size 0x2
+    u8 src[4]; // offset 0x8, size 0x4
+    u8 dst[4]; // offset 0xC, size 0x4
+    u32 expire; // offset 0x10, size 0x4
+} TCPTimeWaitEntry;
+
 BOOL TCPLookupTimeWaitInfo(const u8* src, u16 srcPort, const u8* dst, u16 dstPort);
 
+void TCPSetTimeWaitTable(void* buf, s32 size);
+BOOL TCPEnterTimeWait(const u8* src, u16 srcPort, const u8* dst, u16 dstPort);
+BOOL TCPRemoveTimeWait(const u8* src, u16 srcPort, const u8* dst, u16 dstPort);
+BOOL TCPLookupTimeWait(const u8* src, u16 srcPort, const u8* dst, u16 dstPort);
+s32 TCPGetTimeWaitCount(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,39 @@
+#ifndef __DOLPHIN_OS_IP_TIMER_H__
+#define __DOLPHIN_OS_IP_TIMER_H__
+
+#include <dolphin/os.h>
+#include <dolphin/ip/IFQueue.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IP_TIMER_SLOTS 256
+#define IP_TIMER_TICK OSMillisecondsToTicks(10)
+
+// IPTimer.slot: wheel slot + 1 while armed. A zeroed IPTimer is idle.
+#define IP_TIMER_IDLE 0
+#define IP_TIMER_FIRING -1
+
+typedef struct IPTimer IPTimer;
+typedef void (*IPTimerHandler)(IPTimer* timer);
+
+struct IPTimer {
+    // total size: 0x18
+    IFLink link; // offset 0x0, size 0x8
+    OSTime expire; // offset 0x8, size 0x8
+    IPTimerHandler handler; // offset 0x10, size 0x4
+    s32 slot; // offset 0x14, size 0x4
+};
+
+#define IPTimerIsArmed(timer) ((timer)->expire != 0)
+
+void IPTimerCreate(IPTimer* timer);
+void IPTimerSet(IPTimer* timer, OSTime delay, IPTimerHandler handler);
+void IPTimerCancel(IPTimer* timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
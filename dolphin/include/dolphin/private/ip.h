@@ -14,6 +14,11 @@ extern PPPConf PPPIpcpConf;
 extern const u8 IPLimited[4];
 extern IFQueue TCPInfoQueue;
 
+void __SONotify(IPInfo* info);
+BOOL __SOAttachSendBuffer(TCPInfo* tcp);
+s32 __SOClampWindow(TCPInfo* tcp, s32 win);
+void __SOTuneRecvBuffer(TCPInfo* tcp);
+
 #ifdef __cplusplus
 }
 #endif
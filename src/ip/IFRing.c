@@ -108,74 +108,82 @@ u8* IFRingPut(u8* buf /* r27 */, s32 size /* r1+0xC */, u8* head /* r31 */, s32
     return head;
 }
 
-// Range: 0x3FC -> 0x650
-static s32 MargeBlock(u8* ptr /* r23 */, s32 len /* r24 */, IFBlock* blockTable /* r25 */, s32 maxblock /* r20 */, s32 size /* r21 */, u8* tail /* r27 */) {
-    // Local variables
-    IFBlock* block; // r31
-    IFBlock* end; // r28
-    s32 pl; // r26
-    s32 pr; // r30
-    s32 pb; // r29
+static s32 GetBlockOffset(const u8* ptr, const u8* tail, s32 size) {
+    return tail <= ptr ? (s32)ptr - (s32)tail : (s32)ptr + size - (s32)tail;
+}
+
+/*
+ * blockTable holds the out-of-order extents of the ring as a packed array;
+ * unused entries are zero. A block that is added or grows by a merge moves
+ * to the end, so the table runs from least to most recently received, the
+ * order SACK blocks are reported in (RFC 2018). If data arrives at tail,
+ * returns the length now contiguous from tail and drops the blocks it
+ * absorbed. Otherwise records the block and returns 0, or returns -1
+ * without recording it if it would need a new entry and the table is full.
+ * Blocks already recorded are never discarded, because they may have been
+ * SACKed.
+ */
+static s32 MargeBlock(u8* ptr, s32 len, IFBlock* blockTable, s32 maxblock, s32 size, u8* tail) {
+    IFBlock* block;
+    IFBlock* end;
+    s32 pl;
+    s32 pr;
+    s32 pb;
 
     ASSERTLINE(318, 1 < maxblock && blockTable);
     ASSERTLINE(319, 0 <= len);
 
-    pl = tail <= ptr ? (s32)ptr - (s32)tail : (s32)ptr + size - (s32)tail;
+    pl = GetBlockOffset(ptr, tail, size);
     pr = pl + len;
     end = blockTable + maxblock;
-    if (tail == ptr) {
-        block = blockTable;
-
-        while (block < end && block->ptr) {
-            pb = tail <= block->ptr ? (s32)block->ptr - (s32)tail : (s32)block->ptr + size - (s32)tail;
-            if (pb <= pr) {
-                pr = pb + block->len > pr ? pb + block->len : pr;
-                len = pr - pl;
-                memmove(block, block + 1, (s32)end - (s32)(block + 1));
-                memset(end - 1, 0, sizeof(IFBlock));
-            } else {
-                block++;
-            }
-        }
 
-        return len;
-    } else {
-        block = blockTable;
-        while (block < end && block->ptr) {
-            pb = tail <= block->ptr ? (s32)block->ptr - (s32)tail : (s32)block->ptr + size - (s32)tail;
-            if (pl <= pb + block->len && pb <= pr) {
-                pr = pb + block->len > pr ? pb + block->len : pr;
-
-                if (pb < pl) {
-                    pl = pb;
-                    ptr = block->ptr;
-                }
-
-                len = pr - pl;
-                memmove(block, block + 1, (s32)end - (s32)(block + 1));
-                memset(end - 1, 0, sizeof(IFBlock));
-            } else {
-                block++;
+    block = blockTable;
+    while (block < end && block->ptr) {
+        pb = GetBlockOffset(block->ptr, tail, size);
+        if (pl <= pb + block->len && pb <= pr) {
+            if (pb < pl) {
+                pl = pb;
+                ptr = block->ptr;
+            }
+            if (pr < pb + block->len) {
+                pr = pb + block->len;
             }
-        }
 
-        if (block < end) {
-            ASSERTLINE(367, block->ptr == NULL);
-            block->ptr = ptr;
-            block->len = len;
+            memmove(block, block + 1, (s32)end - (s32)(block + 1));
+            memset(end - 1, 0, sizeof(IFBlock));
         } else {
-            memmove(blockTable, blockTable + 1, (s32)end - (s32)(blockTable + 1));
-            block = end - 1;
-            block->ptr = ptr;
-            block->len = len;
+            block++;
         }
+    }
 
-        return 0;
+    if (tail == ptr) {
+        return pr - pl;
     }
+
+    if (block == end) {
+        return -1;
+    }
+
+    block->ptr = ptr;
+    block->len = pr - pl;
+    return 0;
 }
 
-// Range: 0x650 -> 0x7D4
+/* Writes *adv bytes at offset past the used part of the ring and tracks the
+ * extent in blockTable. On return *adv is the number of bytes that became
+ * contiguous with the used part, or 0 if the data is held out of order. A
+ * segment that needs a new block while the table is full is dropped. */
 u8* IFRingInEx(u8* buf /* r21 */, s32 size /* r27 */, u8* head /* r28 */, s32 used /* r19 */, s32 offset /* r22 */, const u8* data /* r23 */, s32 * adv /* r20 */, IFBlock* blockTable /* r1+0x24 */, s32 maxblock /* r1+0x68 */) {
+    head = IFRingInBlock(buf, size, head, used, offset, data, adv, blockTable, maxblock);
+    if (*adv < 0) {
+        *adv = 0;
+    }
+    return head;
+}
+
+/* As IFRingInEx, but reports a segment dropped for want of a block with
+ * *adv = -1 */
+u8* IFRingInBlock(u8* buf, s32 size, u8* head, s32 used, s32 offset, const u8* data, s32* adv, IFBlock* blockTable, s32 maxblock) {
     // Local variables
     u8* end; // r26
     u8* tail; // r25
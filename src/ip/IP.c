@@ -1,6 +1,8 @@
 #include <dolphin/private/ip.h>
 
 static u16 Id = 1;
+static IPSegState SegTable[IP_SEG_NUM];
+static IPOffload OffloadTable[IP_OFFLOAD_NUM];
 const u8 IPAddrAny[4] = { 0, 0, 0, 0 }; // 0.0.0.0
 const u8 IPLoopbackAddr[4] = { 127, 0, 0, 1 }; // 127.0.0.1
 const u8 IPLimited[4] = { 255, 255, 255, 255 }; // 255.255.255.255
@@ -112,6 +114,40 @@ char* IPNtoA(const u8* addr) {
     return ascii;
 }
 
+static BOOL IsReusePortPeer(const IPInfo* info, const IPInfo* match) {
+    return (info->flag & IP_FLAG_REUSEPORT) != 0 && info->local.port == match->local.port &&
+           IPEQ(info->local.addr, match->local.addr) && IPEQ(info->remote.addr, IPAddrAny);
+}
+
+/* Spread new flows over every listener of a reuse-port group by 4-tuple
+ * hash, so that each member keeps a stable share of the connections. */
+static IPInfo* SelectReusePort(IFQueue* queue, IPInfo* match, const u8* srcAddr, const u8* dstAddr, u16 src, u16 dst) {
+    IPInfo* info;
+    IPInfo* next;
+    u32 count;
+    u32 pick;
+
+    count = 0;
+    IFQueueIterator(IPInfo*, queue, info, next) {
+        if (IsReusePortPeer(info, match)) {
+            count++;
+        }
+    }
+
+    if (count <= 1) {
+        return match;
+    }
+
+    pick = IPHashTuple(dstAddr, dst, srcAddr, src) % count;
+    IFQueueIterator(IPInfo*, queue, info, next) {
+        if (IsReusePortPeer(info, match) && pick-- == 0) {
+            return info;
+        }
+    }
+
+    return match;
+}
+
 IPInfo* IPLookupInfo(IFQueue* queue, u8* srcAddr, u8* dstAddr, u16 src, u16 dst, u32 flag) {
     IPInfo* info;
     IPInfo* next;
@@ -168,6 +204,10 @@ IPInfo* IPLookupInfo(IFQueue* queue, u8* srcAddr, u8* dstAddr, u16 src, u16 dst,
         }
     }
 
+    if (match != NULL && (match->flag & IP_FLAG_REUSEPORT) != 0 && IPEQ(match->remote.addr, IPAddrAny)) {
+        match = SelectReusePort(queue, match, srcAddr, dstAddr, src, dst);
+    }
+
     return match;
 }
 
@@ -199,7 +239,8 @@ BOOL IPBind(IFQueue* queue, IPInfo* info, const IPSocket* socket, BOOL reuse) {
 
     IFQueueIterator(IPInfo*, queue, iter, next) {
         if (iter != info && iter->local.port == socket->port && IPEQ(iter->local.addr, socket->addr) &&
-            (reuse == FALSE || (iter->remote.port == info->remote.port && IPEQ(iter->remote.addr, info->remote.addr)))
+            (reuse == FALSE || (iter->remote.port == info->remote.port && IPEQ(iter->remote.addr, info->remote.addr))) &&
+            ((iter->flag & IP_FLAG_REUSEPORT) == 0 || (info->flag & IP_FLAG_REUSEPORT) == 0)
         ) {
             return -5;
         }
@@ -245,6 +286,7 @@ s32 IPConnect(IFQueue* queue, IPInfo* info, const IPSocket* socket, u16* last) {
     IPInfo* next;
     IPInterface* interface;
     const u8* localAddr;
+    int skip;
 
     if (socket == NULL || socket->len != 8 || socket->family != 2 || socket->port == 0 || IP_CLASSE(socket->addr)) {
         return -12;
@@ -277,12 +319,16 @@ s32 IPConnect(IFQueue* queue, IPInfo* info, const IPSocket* socket, u16* last) {
     }
 
     if (info->local.port == 0) {
+        /* Skip ports whose tuple with this peer is still in TIME_WAIT, but
+         * give up once every anonymous port has been tried */
+        skip = 0;
         do {
             info->local.port = IPGetAnonPort(queue, last);
-            if (info->local.port == 0) {
+            if (info->local.port == 0 || 0x3FFF < skip++) {
+                info->local.port = 0;
                 return -7;
             }
-        } while (info->proto == IP_PROTO_TCP && TCPLookupTimeWaitInfo(socket->addr, socket->port, localAddr, info->local.port));
+        } while (info->proto == IP_PROTO_TCP && TCPLookupTimeWait(socket->addr, socket->port, localAddr, info->local.port));
     } else {
         IFQueueIterator(IPInfo*, queue, iter, next) {
             if (iter != info && iter->local.port == info->local.port && iter->remote.port == info->remote.port &&
@@ -291,7 +337,7 @@ s32 IPConnect(IFQueue* queue, IPInfo* info, const IPSocket* socket, u16* last) {
             }
         }
 
-        if (info->proto == IP_PROTO_TCP && TCPLookupTimeWaitInfo(socket->addr, socket->port, localAddr, info->local.port)) {
+        if (info->proto == IP_PROTO_TCP && TCPLookupTimeWait(socket->addr, socket->port, localAddr, info->local.port)) {
             return -5;
         }
     }
@@ -362,6 +408,15 @@ s32 IPGetSockOpt(IPInfo* info, int level, int optname, void* optval, int* optlen
                     rc = -12;
                 }
                 break;
+            case IP_OPT_REUSEPORT:
+                if (*(u32*)optlen >= sizeof(u32)) {
+                    *(u32*)optval = (info->flag & IP_FLAG_REUSEPORT) ? TRUE : FALSE;
+                    *optlen = sizeof(u32);
+                    rc = 0;
+                } else {
+                    rc = -12;
+                }
+                break;
         }
     }
 
@@ -415,6 +470,19 @@ s32 IPSetSockOpt(IPInfo* info, int level, int optname, void* optval, int optlen)
                     rc = -12;
                 }
                 break;
+            case IP_OPT_REUSEPORT:
+                if (optlen >= sizeof(u32)) {
+                    if (*(u32*)optval) {
+                        info->flag |= IP_FLAG_REUSEPORT;
+                    } else {
+                        info->flag &= ~IP_FLAG_REUSEPORT;
+                    }
+
+                    rc = 0;
+                } else {
+                    rc = -12;
+                }
+                break;
             case IP_OPT_JOIN_MCAST:
                 if (optlen >= sizeof(SOIpMreq)) {
                     const SOIpMreq* mreq = (const SOIpMreq*)optval;
@@ -490,6 +558,20 @@ u16 IPCheckSum(IPHeader* ip) {
     return sum ^ 0xFFFF;
 }
 
+u32 IPHashTuple(const u8* local, u16 localPort, const u8* remote, u16 remotePort) {
+    u32 hash;
+
+    /* Fold the 4-tuple into one word, then the murmur3 finalizer */
+    hash = IPU32(local) ^ (IPU32(remote) * 0x9E3779B1);
+    hash += ((u32)localPort << 16) | remotePort;
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6B;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
 void IPIn(IPInterface* interface, IPHeader* ip, s32 len, u32 flag) {
     BOOL bcast;
 
@@ -537,7 +619,7 @@ void IPIn(IPInterface* interface, IPHeader* ip, s32 len, u32 flag) {
             return;
         }
     }
-    
+
     switch (ip->proto) {
         case IP_PROTO_ICMP:
             ICMPIn(interface, ip, flag);
@@ -558,12 +640,238 @@ void IPIn(IPInterface* interface, IPHeader* ip, s32 len, u32 flag) {
     ip->verlen = 0;
 }
 
+/* Segment buffers from interface->alloc: the datagram with room for every
+ * vector, a pointer back to the IPSegState, then the headers */
+#define IP_SEG_STATE_OFFSET (sizeof(IFDatagram) + (IF_MAX_VEC - 1) * sizeof(IFVec))
+#define IP_SEG_HEADER_OFFSET (IP_SEG_STATE_OFFSET + sizeof(IPSegState*))
+
+/* Must be called with interrupts disabled. Drops one count and completes
+ * the super-segment on the last. */
+static void PutSegState(IPSegState* state) {
+    IFDatagram* datagram;
+
+    if (--state->left == 0) {
+        datagram = state->datagram;
+        state->datagram = NULL;
+        if (datagram->callback) {
+            (*datagram->callback)(datagram->param, state->result);
+        }
+    }
+}
+
+static void SegCallback(void* param, s32 result) {
+    IFDatagram* seg;
+    IPSegState* state;
+    BOOL enabled;
+
+    seg = (IFDatagram*)param;
+    state = *(IPSegState**)((u8*)seg + IP_SEG_STATE_OFFSET);
+    enabled = OSDisableInterrupts();
+    if (state->result >= 0) {
+        state->result = result;
+    }
+
+    state->interface->free(state->interface, seg, state->size);
+    PutSegState(state);
+    OSRestoreInterrupts(enabled);
+}
+
+/* Records the offload capabilities of interface, IF_OFFLOAD_TSO or 0. Returns
+ * -42 if IP_OFFLOAD_NUM interfaces already have some. */
+s32 IPSetOffload(IPInterface* interface, u32 flag) {
+    IPOffload* entry;
+    IPOffload* empty;
+    BOOL enabled;
+
+    empty = NULL;
+    enabled = OSDisableInterrupts();
+    for (entry = OffloadTable; entry < &OffloadTable[IP_OFFLOAD_NUM]; entry++) {
+        if (entry->interface == interface) {
+            break;
+        }
+        if (entry->interface == NULL && empty == NULL) {
+            empty = entry;
+        }
+    }
+
+    if (entry == &OffloadTable[IP_OFFLOAD_NUM]) {
+        entry = empty;
+    }
+
+    if (entry == NULL) {
+        OSRestoreInterrupts(enabled);
+        return (flag != 0) ? -42 : 0;
+    }
+
+    entry->interface = (flag != 0) ? interface : NULL;
+    entry->flag = flag;
+    OSRestoreInterrupts(enabled);
+    return 0;
+}
+
+u32 IPGetOffload(IPInterface* interface) {
+    IPOffload* entry;
+
+    for (entry = OffloadTable; entry < &OffloadTable[IP_OFFLOAD_NUM]; entry++) {
+        if (entry->interface == interface) {
+            return entry->flag;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Software segmentation. datagram is a TCP datagram too large for the
+ * interface whose first vector starts with the IP and TCP headers. It is
+ * sent as segments of segSize payload bytes, each with a copy of the
+ * headers in a buffer from interface->alloc and vectors pointing into the
+ * original payload. Sequence numbers, lengths, IDs and checksums are fixed
+ * per segment, and FIN and PSH are left on the last one only.
+ *
+ * datagram itself never reaches the interface; its callback runs once every
+ * segment handed over has completed, with the first error if there was one.
+ * interface->out has no result of its own, so a driver reports a failed
+ * segment through its callback; once one has failed, the segments not yet
+ * handed over are not sent. Each segment buffer is freed as it completes.
+ */
+static s32 OutSegments(IPInterface* interface, IFDatagram* datagram, s32 segSize) {
+    IPSegState* state;
+    IPHeader* ip;
+    TCPHeader* tcp;
+    IFDatagram* seg;
+    IPHeader* segIp;
+    TCPHeader* segTcp;
+    IFQueue list;
+    IFVec* vec;
+    s32 hlen;
+    s32 total;
+    s32 off;
+    s32 len;
+    s32 n;
+    s32 size;
+    s32 rest;
+    int i;
+    u8* ptr;
+    s32 left;
+    BOOL enabled;
+
+    ip = (IPHeader*)datagram->vec[0].data;
+    tcp = (TCPHeader*)((u8*)ip + IP_HLEN(ip));
+    hlen = IP_HLEN(ip) + TCP_HLEN(tcp);
+    total = ip->len - hlen;
+    n = (total + segSize - 1) / segSize;
+    size = IP_SEG_HEADER_OFFSET + hlen;
+
+    enabled = OSDisableInterrupts();
+    for (state = SegTable; state < &SegTable[IP_SEG_NUM]; state++) {
+        if (state->datagram == NULL) {
+            break;
+        }
+    }
+
+    if (state == &SegTable[IP_SEG_NUM]) {
+        OSRestoreInterrupts(enabled);
+        return -42;
+    }
+
+    /* The count held here keeps the callback from running before the last
+     * segment has been handed over */
+    state->datagram = datagram;
+    state->interface = interface;
+    state->size = size;
+    state->left = 1;
+    state->result = 0;
+    OSRestoreInterrupts(enabled);
+
+    IFQueueInit(&list);
+    for (i = 0; i < n; i++) {
+        seg = (IFDatagram*)interface->alloc(interface, size);
+        if (seg == NULL) {
+            while (list.next != NULL) {
+                IFQueueDequeueHead(IFDatagram*, &list, seg);
+                interface->free(interface, seg, size);
+            }
+
+            enabled = OSDisableInterrupts();
+            state->datagram = NULL;
+            OSRestoreInterrupts(enabled);
+            return -42;
+        }
+        IFQueueEnqueueTail(IFDatagram*, &list, seg);
+    }
+
+    i = 0;
+    ptr = (u8*)datagram->vec[0].data + hlen;
+    left = datagram->vec[0].len - hlen;
+    for (off = 0; off < total; off += len) {
+        IFQueueDequeueHead(IFDatagram*, &list, seg);
+        len = (segSize < total - off) ? segSize : total - off;
+
+        enabled = OSDisableInterrupts();
+        if (state->result < 0) {
+            /* An earlier segment failed; drop the rest */
+            OSRestoreInterrupts(enabled);
+            interface->free(interface, seg, size);
+            while (list.next != NULL) {
+                IFQueueDequeueHead(IFDatagram*, &list, seg);
+                interface->free(interface, seg, size);
+            }
+            break;
+        }
+        state->left++;
+        OSRestoreInterrupts(enabled);
+
+        *(IPSegState**)((u8*)seg + IP_SEG_STATE_OFFSET) = state;
+        segIp = (IPHeader*)((u8*)seg + IP_SEG_HEADER_OFFSET);
+        segTcp = (TCPHeader*)((u8*)segIp + IP_HLEN(ip));
+        memmove(segIp, ip, hlen);
+        segIp->len = (u16)(hlen + len);
+        segIp->id = Id++;
+        segIp->sum = 0;
+        segIp->sum = IPCheckSum(segIp);
+        segTcp->seq = tcp->seq + off;
+        if (off + len < total) {
+            segTcp->flag &= ~(TCP_FLAG_FIN | TCP_FLAG_PSH);
+        }
+
+        IFInitDatagram(seg, ETH_IP, 1);
+        seg->vec[0].data = segIp;
+        seg->vec[0].len = hlen;
+        for (rest = len; 0 < rest; rest -= vec->len) {
+            while (left == 0) {
+                i++;
+                ptr = (u8*)datagram->vec[i].data;
+                left = datagram->vec[i].len;
+            }
+            vec = &seg->vec[seg->nVec++];
+            vec->data = ptr;
+            vec->len = (rest < left) ? rest : left;
+            ptr += vec->len;
+            left -= vec->len;
+        }
+
+        segTcp->sum = 0;
+        segTcp->sum = TCPCheckSum(seg->vec, seg->nVec);
+        memmove(seg->dst, datagram->dst, sizeof(seg->dst));
+        seg->callback = SegCallback;
+        seg->param = seg;
+        (*interface->out)(interface, seg);
+    }
+
+    enabled = OSDisableInterrupts();
+    PutSegState(state);
+    OSRestoreInterrupts(enabled);
+    return 0;
+}
+
 s32 IPOut(IFDatagram* datagram) {
     IPHeader* ip;
     IPInterface* interface;
     TCPHeader* tcp;
     UDPHeader* udp;
     IGMP* igmp;
+    s32 segSize;
+    s32 hlen;
 
     ASSERTLINE(1035, 0 < datagram->nVec && datagram->nVec <= IF_MAX_VEC);
     ip = (IPHeader*)datagram->vec[0].data;
@@ -580,7 +888,20 @@ s32 IPOut(IFDatagram* datagram) {
         }
     }
 
-    if (interface->mtu < ip->len && (ip->frag & IP_DONT_FRAG) != 0) {
+    /* A TCP datagram larger than the MTU is split into segments rather
+     * than fragmented. The headers must be in the first vector, and a
+     * vector must be left spare for their copy. */
+    segSize = 0;
+    if (ip->proto == IP_PROTO_TCP && interface->mtu < ip->len && datagram->nVec < IF_MAX_VEC) {
+        tcp = (TCPHeader*)(((u8*)ip) + IP_HLEN(ip));
+        hlen = IP_HLEN(ip) + TCP_HLEN(tcp);
+        segSize = interface->mtu - hlen;
+        if (datagram->vec[0].len < hlen || segSize <= 0) {
+            segSize = 0;
+        }
+    }
+
+    if (segSize == 0 && interface->mtu < ip->len && (ip->frag & IP_DONT_FRAG) != 0) {
         return -17;
     }
 
@@ -589,6 +910,10 @@ s32 IPOut(IFDatagram* datagram) {
     }
 
 
+    if (segSize != 0 && !(IPGetOffload(interface) & IF_OFFLOAD_TSO)) {
+        return OutSegments(interface, datagram, segSize);
+    }
+
     ip->sum = 0;
     ip->sum = IPCheckSum(ip);
 
@@ -607,6 +932,10 @@ s32 IPOut(IFDatagram* datagram) {
             }
             break;
         case IP_PROTO_TCP:
+            if (segSize != 0) {
+                /* The interface fixes up each segment */
+                break;
+            }
             tcp = (TCPHeader*)(((u8*)ip) + IP_HLEN(ip));
             tcp->sum = 0;
             tcp->sum = TCPCheckSum(datagram->vec, datagram->nVec);
@@ -8,7 +8,7 @@
 #define NULL 0
 #define ARP_CACHE_SIZE 64
 
-static ARPCache Cache[ARP_CACHE_SIZE]; // size: 0x2A00, address: 0x0
+static ARPCache Cache[ARP_CACHE_SIZE]; // size: 0x2600, address: 0x0
 static IFQueue Up; // size: 0x8, address: 0x0
 static IFQueue Free; // size: 0x8, address: 0x8
 static u8 HwBroadcastAddr[6] = { 255, 255, 255, 255, 255, 255 }; // size: 0x6, address: 0x0
@@ -150,7 +150,7 @@ static void Revalidate(ARPCache* cache /* r31 */) {
             } else {
                 IPRecoverGateway(cache->prAddr);
                 IFQueueDequeueEntry(ARPCache*, &Up, cache);
-                OSCancelAlarm(&cache->alarm);
+                IPTimerCancel(&cache->alarm);
                 cache->state = 0;
                 IFQueueEnqueueHead(ARPCache*, &Free, cache);
                 DiscardPendingPackets(cache, -2);
@@ -164,7 +164,7 @@ static void Revalidate(ARPCache* cache /* r31 */) {
 }
 
 // // Range: 0x6B8 -> 0x6F0
-static void TimeoutCallback(OSAlarm* alarm /* r1+0x8 */, OSContext* context) {
+static void TimeoutCallback(IPTimer* alarm /* r1+0x8 */) {
     // Local variables
     ARPCache* cache; // r31
 
@@ -180,8 +180,7 @@ static void SendCallback(ARPCache* cache /* r31 */) {
     switch (cache->state) {
         case 1:
         case ARP_CACHE_POLLING:
-            OSCancelAlarm(&cache->alarm);
-            OSSetAlarm(&cache->alarm, OSSecondsToTicks((OSTime)cache->rxmit), TimeoutCallback);
+            IPTimerSet(&cache->alarm, OSSecondsToTicks((OSTime)cache->rxmit), TimeoutCallback);
             break;
     }
 }
@@ -196,7 +195,7 @@ void ARPInit(void) {
     IFQueueInit(&Up);
     IFQueueInit(&Free);
     for (ent = &Cache[0]; ent < &Cache[ARP_CACHE_SIZE]; ent++) {
-        OSCreateAlarm(&ent->alarm);
+        IPTimerCreate(&ent->alarm);
         IFQueueEnqueueTail(ARPCache*, &Free, ent);
     }
     
@@ -307,7 +306,7 @@ static ARPCache* ARPAlloc(u8* prAddr /* r25 */, BOOL alloc /* r1+0xC */) {
     } else {
         IFQueueDequeueTail(ARPCache*, &Up, free);
         ARPCancel(free);
-        OSCancelAlarm(&free->alarm);
+        IPTimerCancel(&free->alarm);
         if (free->state == 1) {
             DiscardPendingPackets(free, -7);
         }
@@ -317,7 +316,7 @@ static ARPCache* ARPAlloc(u8* prAddr /* r25 */, BOOL alloc /* r1+0xC */) {
 
     memset(free, 0, sizeof(ARPCache));
     IFQueueInit(&free->queue);
-    OSCreateAlarm(&free->alarm);
+    IPTimerCreate(&free->alarm);
     free->rxmit = 1;
     memmove(free->prAddr, prAddr, sizeof(free->prAddr));
     IFQueueEnqueueHead(ARPCache*, &Up, free);
@@ -339,7 +338,7 @@ void ARPAdd(IPInterface* interface /* r1+0x8 */, u8* prAddr /* r1+0xC */, u8* hw
         cache->state = ARP_CACHE_RESOVLED;
         cache->interface = interface;
         cache->rxmit = 1200;
-        OSSetAlarm(&cache->alarm, OSSecondsToTicks((OSTime)cache->rxmit), TimeoutCallback);
+        IPTimerSet(&cache->alarm, OSSecondsToTicks((OSTime)cache->rxmit), TimeoutCallback);
         memmove(cache->hwAddr, hwAddr, 6);
     }
 }
@@ -414,9 +413,8 @@ static void ARPUpdate(IPInterface* interface /* r27 */, ARPHeader* arp /* r29 */
     cache = ARPAlloc(src, IPEQ(ARPHeader2Addr(arp), interface->addr) || IPEQ(ARPHeader2Addr(arp), interface->alias));
     if (cache != NULL) {
         ARPCancel(cache);
-        OSCancelAlarm(&cache->alarm);
         cache->rxmit = 1200;
-        OSSetAlarm(&cache->alarm, OSSecondsToTicks((OSTime)cache->rxmit), TimeoutCallback);
+        IPTimerSet(&cache->alarm, OSSecondsToTicks((OSTime)cache->rxmit), TimeoutCallback);
         state = cache->state;
         cache->state = ARP_CACHE_RESOVLED;
         memmove(cache->hwAddr, ARPHeader2MACAddr(arp), 6);
@@ -688,7 +686,7 @@ void ARPRefresh(void) {
     while (Up.next) {
         IFQueueDequeueHead(ARPCache*, &Up, cache);
         ARPCancel(cache);
-        OSCancelAlarm(&cache->alarm);
+        IPTimerCancel(&cache->alarm);
         cache->state = 0;
         IFQueueEnqueueHead(ARPCache*, &Free, cache);
         DiscardPendingPackets(cache, 0);
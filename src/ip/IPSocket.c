@@ -3,10 +3,103 @@
 static SOAllocFunc Alloc = NULL;
 static SOFreeFunc Free = NULL;
 static u32 Allocated = 0;
+static u32 SoftLimit = 0;
+static u32 HardLimit = 0;
 
 #define SO_TABLE_NUM 256
 static SONode SocketTable[SO_TABLE_NUM];
 static IFQueue LingerQueue;
+
+typedef struct SOEpoll SOEpoll;
+
+typedef struct SOEpollItem {
+    // total size: 0x20
+    IFLink link; // offset 0x0, size 0x8
+    IFLink linkHash; // offset 0x8, size 0x8
+    SOEpoll* set; // offset 0x10, size 0x4
+    IPInfo* info; // offset 0x14, size 0x4
+    int fd; // offset 0x18, size 0x4
+    s16 events; // offset 0x1C, size 0x2
+    s16 ready; // offset 0x1E, size 0x2
+} SOEpollItem;
+
+struct SOEpoll {
+    // total size: 0x18
+    BOOL used; // offset 0x0, size 0x4
+    IFQueue queueReady; // offset 0x4, size 0x8
+    OSThreadQueue queueThread; // offset 0xC, size 0x8
+    s32 count; // offset 0x14, size 0x4
+};
+
+typedef struct SOEpollWaiter {
+    // total size: 0x30
+    OSAlarm alarm; // offset 0x0, size 0x28
+    SOEpoll* set; // offset 0x28, size 0x4
+} SOEpollWaiter;
+
+#define SO_EPOLL_NUM 8
+#define SO_EPOLL_HASH_NUM 64
+#define SO_EPOLL_HASH(info) ((((u32)(info)) >> 5) % SO_EPOLL_HASH_NUM)
+#define SO_EPOLL_POLL OSMillisecondsToTicks(10)
+static SOEpoll EpollTable[SO_EPOLL_NUM];
+static IFQueue EpollHash[SO_EPOLL_HASH_NUM];
+
+typedef struct SOAsyncSlot {
+    // total size: 0x24
+    SOAsync* open; // offset 0x0, size 0x4
+    SOAsync* send; // offset 0x4, size 0x4
+    SOAsync* recv; // offset 0x8, size 0x4
+    SOAsync* close; // offset 0xC, size 0x4
+    IFQueue queueAccept; // offset 0x10, size 0x8
+    s32 refill; // offset 0x18, size 0x4
+    IFQueue queueWaiter; // offset 0x1C, size 0x8
+} SOAsyncSlot;
+
+static SOAsyncSlot AsyncTable[SO_TABLE_NUM];
+
+typedef struct SOWaiter {
+    // total size: 0x14
+    IFLink link; // offset 0x0, size 0x8
+    OSThreadQueue queue; // offset 0x8, size 0x8
+    BOOL woken; // offset 0x10, size 0x4
+} SOWaiter;
+
+typedef struct SOShardBinding {
+    // total size: 0x8
+    OSThread* thread; // offset 0x0, size 0x4
+    int shard; // offset 0x4, size 0x4
+} SOShardBinding;
+
+#define SO_SHARD_BINDING_NUM 16
+static SOShardBinding ShardBinding[SO_SHARD_BINDING_NUM];
+static int ShardNum = 1;
+
+typedef struct SOBuffer {
+    // total size: 0x8
+    IFLink link; // offset 0x0, size 0x8
+} SOBuffer;
+
+#define SO_BUFFER_RESERVE 4
+#define SO_BUFFER_SWEEP OSSecondsToTicks(1)
+static IFQueue BufferPool;
+static s32 BufferSize;
+static s32 BufferCount;
+static IPTimer BufferAlarm;
+static BOOL BufferRelease;
+
+typedef struct SOTuneSlot {
+    // total size: 0x18
+    TCPInfo* tcp; // offset 0x0, size 0x4
+    s32 seq; // offset 0x4, size 0x4
+    OSTime time; // offset 0x8, size 0x8
+    s32 grown; // offset 0x10, size 0x4
+    BOOL locked; // offset 0x14, size 0x4
+} SOTuneSlot;
+
+static SOTuneSlot TuneTable[SO_TABLE_NUM];
+static s32 TuneSocketMax = SO_BUF_MAX;
+static s32 TuneTotalMax = 512 * 1024;
+static s32 TuneTotal;
 static SOSockAddrIn SockAnyIn = { 8, 2, 0, { 0 } };
 static u8* TimeWaitBuf = NULL;
 static s32 TimeWaitBufSize = 0;
@@ -29,17 +122,34 @@ static BOOL OnReset(BOOL);
 static OSResetFunctionInfo ResetFunctionInfo = { &OnReset, 110, NULL, NULL };
 
 static void LingerCallback(TCPInfo* info);
+static void RemoveEpollItems(IPInfo* info);
+static void CompleteAcceptAsync(SONode* node, TCPInfo* listening);
+static void CancelAsync(int s);
+static void SweepBuffers(IPTimer* alarm);
+static s32 GetRwin(void);
+static void TuneRecvBuffer(int s, SONode* node, TCPInfo* tcp);
+static void ReleaseTune(int s);
+static void ReleaseRecvBuffers(void);
+static s32 ResizeTCPBuffer(TCPInfo* tcp, int optname, s32 size);
+static void PutNode(SONode* node);
 
 void* SOAlloc(u32 name, s32 size) {
     void* ptr;
     BOOL enabled;
 
     ASSERTLINE(303, Alloc);
-    
+
+    if (HardLimit != 0 && HardLimit < Allocated + size) {
+        return NULL;
+    }
+
     ptr = (*Alloc)(name, size);
     if (ptr != NULL) {
         enabled = OSDisableInterrupts();
         Allocated += size;
+        if (SOGetMemoryPressure() != 0 && State == 1 && !IPTimerIsArmed(&BufferAlarm)) {
+            IPTimerSet(&BufferAlarm, SO_BUFFER_SWEEP, SweepBuffers);
+        }
         OSRestoreInterrupts(enabled);
     }
 
@@ -64,6 +174,216 @@ void SOFree(u32 name, void* ptr, s32 size) {
     }
 }
 
+/* TCP rings of BufferSize bytes are recycled through BufferPool, so opening
+ * and closing connections rarely reaches the allocator. */
+static void* GetBuffer(u32 name, s32 size, BOOL alloc) {
+    SOBuffer* buffer;
+    BOOL enabled;
+
+    buffer = NULL;
+    if (size == BufferSize) {
+        enabled = OSDisableInterrupts();
+        if (BufferPool.next != NULL) {
+            IFQueueDequeueHead(SOBuffer*, &BufferPool, buffer);
+            BufferCount--;
+        }
+        OSRestoreInterrupts(enabled);
+        name = 9;
+    }
+
+    if (buffer == NULL && alloc) {
+        buffer = (SOBuffer*)SOAlloc(name, size);
+    }
+
+    return buffer;
+}
+
+static void PutBuffer(u32 name, void* ptr, s32 size) {
+    BOOL enabled;
+
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (size == BufferSize) {
+        enabled = OSDisableInterrupts();
+        IFQueueEnqueueTail(SOBuffer*, &BufferPool, (SOBuffer*)ptr);
+        BufferCount++;
+        OSRestoreInterrupts(enabled);
+    } else {
+        SOFree(name, ptr, size);
+    }
+}
+
+/* Rings are allocated when the PCB is opened; the TCP core expects both to
+ * be in place before its first segment. */
+static void* AllocBuffer(u32 name, s32 size) {
+    return GetBuffer(name, size, TRUE);
+}
+
+static void FreeBuffers(TCPInfo* tcp) {
+    IPTimerCancel(&tcp->lingerAlarm);
+    TCPPaceCancel(tcp);
+    TCPSackClear(tcp);
+    TCPRackClear(tcp);
+    PutBuffer(2, tcp->recvData, tcp->recvBuff);
+    PutBuffer(1, tcp->sendData, tcp->sendBuff);
+    tcp->recvData = tcp->sendData = NULL;
+}
+
+/* Must be called from thread context */
+static void BalanceBuffers(int reserve) {
+    void* ptr;
+
+    while (BufferCount < reserve) {
+        ptr = SOAlloc(9, BufferSize);
+        if (ptr == NULL) {
+            break;
+        }
+        PutBuffer(9, ptr, BufferSize);
+    }
+
+    while (reserve * 2 < BufferCount) {
+        ptr = GetBuffer(9, BufferSize, FALSE);
+        if (ptr == NULL) {
+            break;
+        }
+        SOFree(9, ptr, BufferSize);
+    }
+}
+
+/* Retries a send ring that could not be allocated when the PCB was opened */
+BOOL __SOAttachSendBuffer(TCPInfo* tcp) {
+    if (tcp->sendData == NULL) {
+        tcp->sendData = tcp->sendPtr = (u8*)GetBuffer(1, tcp->sendBuff, TRUE);
+    }
+
+    return tcp->sendData != NULL;
+}
+
+/* Narrows a receive window under memory pressure: to half the ring past the
+ * soft limit and to a single segment at the hard limit, so connections keep
+ * moving while the peer's in-flight data shrinks. */
+s32 __SOClampWindow(TCPInfo* tcp, s32 win) {
+    s32 limit;
+
+    switch (SOGetMemoryPressure()) {
+        case 1:
+            limit = tcp->recvBuff / 2;
+            break;
+        case 2:
+            limit = tcp->mss;
+            break;
+        default:
+            return win;
+    }
+
+    if (limit < tcp->mss) {
+        limit = tcp->mss;
+    }
+    return (limit < win) ? limit : win;
+}
+
+/* Armed by SOAlloc past the soft limit and rearmed until below it. Runs in
+ * interrupt context, so it only asks the next GetNode to release receive
+ * rings; at most once per SO_BUFFER_SWEEP. */
+static void SweepBuffers(IPTimer* alarm) {
+    if (SOGetMemoryPressure() != 0) {
+        BufferRelease = TRUE;
+        IPTimerSet(&BufferAlarm, SO_BUFFER_SWEEP, SweepBuffers);
+    }
+}
+
+/* Shrinks one receive ring. Past the soft limit only autotuning growth is
+ * given back. At the hard limit every ring larger than the pooled size is
+ * cut back to it, reneging on out-of-order data so that it fits; the peer
+ * still holds that data until it is covered by a cumulative ACK. Must be
+ * called from thread context with mutexRead held. */
+static void ReleaseRecvBuffer(int s, TCPInfo* tcp) {
+    SOTuneSlot* slot;
+    BOOL enabled;
+    s32 grown;
+    s32 size;
+
+    slot = &TuneTable[s];
+    grown = (slot->tcp == tcp) ? slot->grown : 0;
+    if (SOGetMemoryPressure() == 2) {
+        size = BufferSize;
+        enabled = OSDisableInterrupts();
+        memset(tcp->asb, 0, sizeof(tcp->asb));
+        OSRestoreInterrupts(enabled);
+    } else {
+        size = tcp->recvBuff - grown;
+    }
+
+    if (size < tcp->recvBuff && ResizeTCPBuffer(tcp, SO_RCVBUF, size) == 0 && grown != 0) {
+        enabled = OSDisableInterrupts();
+        TuneTotal -= grown;
+        slot->grown = 0;
+        OSRestoreInterrupts(enabled);
+    }
+}
+
+/* Must be called from thread context */
+static void ReleaseRecvBuffers(void) {
+    int s;
+    SONode* node;
+    TCPInfo* tcp;
+    BOOL enabled;
+
+    enabled = OSDisableInterrupts();
+    if (!BufferRelease) {
+        OSRestoreInterrupts(enabled);
+        return;
+    }
+    BufferRelease = FALSE;
+    OSRestoreInterrupts(enabled);
+
+    for (s = 0; s < SO_TABLE_NUM; s++) {
+        node = &SocketTable[s];
+        tcp = NULL;
+        enabled = OSDisableInterrupts();
+        if (0 < node->ref && node->proto == IP_PROTO_TCP && node->info != NULL && BufferSize < ((TCPInfo*)node->info)->recvBuff) {
+            tcp = (TCPInfo*)node->info;
+            node->ref++;
+        }
+        OSRestoreInterrupts(enabled);
+
+        if (tcp == NULL) {
+            continue;
+        }
+
+        if (OSTryLockMutex(&node->mutexRead)) {
+            ReleaseRecvBuffer(s, tcp);
+            OSUnlockMutex(&node->mutexRead);
+        }
+        PutNode(node);
+    }
+}
+
+/* Sets the soft and hard limits on memory taken through SOAlloc; 0 leaves
+ * a limit off. Past the soft limit the stack refuses new TCP connections,
+ * stops growing buffers, gives back autotuning growth and narrows receive
+ * windows. Past the hard limit SOAlloc fails and grown receive rings are
+ * cut back to the pooled size. */
+void SOSetMemoryLimit(u32 soft, u32 hard) {
+    SoftLimit = soft;
+    HardLimit = hard;
+}
+
+/* Returns 0 below the soft limit, 1 above it and 2 at the hard limit */
+int SOGetMemoryPressure(void) {
+    if (HardLimit != 0 && HardLimit <= Allocated) {
+        return 2;
+    }
+
+    if (SoftLimit != 0 && SoftLimit <= Allocated) {
+        return 1;
+    }
+
+    return 0;
+}
+
 u32 SONtoHl(u32 netlong) {
     return netlong;
 }
@@ -118,6 +438,139 @@ char* SOInetNtoP(int af, void* src, char* dst, u32 len) {
     return NULL;
 }
 
+/*
+ * Shards partition the descriptor table only. Descriptors are split into
+ * ShardNum contiguous ranges, and SOSocket and the accept paths place a new
+ * socket in the range of the shard its thread is bound to with SOBindShard.
+ * Threads bound to different shards then work on disjoint descriptors and
+ * their async slots. The stack itself is not sharded: PCB lists, timers and
+ * the receive path are shared, so nothing steers inbound packets.
+ */
+static int GetShard(int s) {
+    return s * ShardNum / SO_TABLE_NUM;
+}
+
+static int GetThreadShard(void) {
+    OSThread* thread;
+    int i;
+
+    thread = OSGetCurrentThread();
+    for (i = 0; i < SO_SHARD_BINDING_NUM; i++) {
+        if (ShardBinding[i].thread == thread) {
+            return ShardBinding[i].shard;
+        }
+    }
+
+    return 0;
+}
+
+/* Must be called with interrupts disabled. Prefers the descriptor range of
+ * the given shard and only spills into the other shards when it is full. */
+static int FindFreeNode(int shard) {
+    int num;
+    int base;
+    int i;
+    int s;
+
+    /* First descriptor s with GetShard(s) == shard */
+    num = ShardNum;
+    base = (shard * SO_TABLE_NUM + num - 1) / num;
+    for (i = 0; i < SO_TABLE_NUM; i++) {
+        s = (base + i) % SO_TABLE_NUM;
+        if (SocketTable[s].ref == 0) {
+            return s;
+        }
+    }
+
+    return -1;
+}
+
+int SOSetShardNum(int num) {
+    if (State != 0) {
+        return -28;
+    }
+
+    if (num < 1 || SO_SHARD_MAX < num) {
+        return -28;
+    }
+
+    ShardNum = num;
+    memset(ShardBinding, 0, sizeof(ShardBinding));
+    return 0;
+}
+
+int SOBindShard(int shard) {
+    BOOL enabled;
+    OSThread* thread;
+    SOShardBinding* free;
+    int i;
+
+    if (shard < 0 || ShardNum <= shard) {
+        return -28;
+    }
+
+    thread = OSGetCurrentThread();
+    free = NULL;
+    enabled = OSDisableInterrupts();
+    for (i = 0; i < SO_SHARD_BINDING_NUM; i++) {
+        if (ShardBinding[i].thread == thread) {
+            free = &ShardBinding[i];
+            break;
+        }
+
+        if (free == NULL && ShardBinding[i].thread == NULL) {
+            free = &ShardBinding[i];
+        }
+    }
+
+    if (free != NULL) {
+        free->thread = thread;
+        free->shard = shard;
+    }
+    OSRestoreInterrupts(enabled);
+
+    return free != NULL ? 0 : -33;
+}
+
+int SOGetShard(int s) {
+    if (s < 0 || SO_TABLE_NUM <= s) {
+        return -8;
+    }
+
+    return GetShard(s);
+}
+
+/* Exclusive waits: each sleeper parks on its own thread queue so that one
+ * event wakes exactly one thread. Must be called with interrupts disabled. */
+static void SleepExclusive(IFQueue* queue, SOWaiter* waiter) {
+    OSInitThreadQueue(&waiter->queue);
+    waiter->woken = FALSE;
+    IFQueueEnqueueTail(SOWaiter*, queue, waiter);
+    OSSleepThread(&waiter->queue);
+    if (!waiter->woken) {
+        IFQueueDequeueEntry(SOWaiter*, queue, waiter);
+    }
+}
+
+static BOOL WakeupOne(IFQueue* queue) {
+    SOWaiter* waiter;
+
+    if (queue->next == NULL) {
+        return FALSE;
+    }
+
+    IFQueueDequeueHead(SOWaiter*, queue, waiter);
+    waiter->woken = TRUE;
+    OSWakeupThread(&waiter->queue);
+    return TRUE;
+}
+
+static void WakeupAll(IFQueue* queue) {
+    while (WakeupOne(queue)) {
+        ;
+    }
+}
+
 static struct SONode* GetNode(int s, IPInfo** pinfo) {
     SONode* node;
     IPInfo* info;
@@ -145,11 +598,13 @@ static struct SONode* GetNode(int s, IPInfo** pinfo) {
         IFQueueDequeueHead(IPInfo*, &queue, info);
 
         tcp = (TCPInfo*)info;
-        SOFree(2, tcp->recvData, tcp->recvBuff);
-        SOFree(1, tcp->sendData, tcp->sendBuff);
+        FreeBuffers(tcp);
         SOFree(0, tcp, sizeof(TCPInfo));
     }
 
+    ReleaseRecvBuffers();
+    BalanceBuffers(State == 1 ? SO_BUFFER_RESERVE >> SOGetMemoryPressure() : 0);
+
     node = NULL;
     enabled = OSDisableInterrupts();
     if (s >= 0 && s < SO_TABLE_NUM) {
@@ -198,8 +653,8 @@ static void PutNode(SONode* node) {
                 break;
             case IP_PROTO_TCP:
                 tcp = (TCPInfo*)info;
-                SOFree(2, tcp->recvData, tcp->recvBuff);
-                SOFree(1, tcp->sendData, tcp->sendBuff);
+                ReleaseTune(node - SocketTable);
+                FreeBuffers(tcp);
                 SOFree(0, tcp, sizeof(TCPInfo));
                 break;
             default:
@@ -360,7 +815,7 @@ int SOStartup(const SOConfig* config) {
             if (config->timeWaitBuffer != 0) {
                 TimeWaitBufSize = config->timeWaitBuffer;
                 TimeWaitBuf = SOAlloc(6, TimeWaitBufSize);
-                TCPSetTimeWaitBuffer(TimeWaitBuf, TimeWaitBufSize);
+                TCPSetTimeWaitTable(TimeWaitBuf, TimeWaitBufSize);
             }
 
             if (config->reassemblyBuffer != 0) {
@@ -406,6 +861,14 @@ int SOStartup(const SOConfig* config) {
         }
 
         LingerQueue.next = LingerQueue.prev = NULL;
+        TCPPaceInit();
+        TCPSackInit();
+        TCPRackInit();
+        TCPFastOpenInit();
+        BufferSize = GetRwin();
+        BufferCount = 0;
+        BufferPool.next = BufferPool.prev = NULL;
+        IPTimerCreate(&BufferAlarm);
         memset(&__SOResolver, 0, sizeof(__SOResolver));
         __SOResolver.zero = NULL;
         ent->name = __SOResolver.name;
@@ -420,6 +883,7 @@ int SOStartup(const SOConfig* config) {
 
 fail:
     if (TimeWaitBuf != NULL) {
+        TCPSetTimeWaitTable(NULL, 0);
         SOFree(6, TimeWaitBuf, TimeWaitBufSize);
     }
 
@@ -445,7 +909,13 @@ int SOCleanup(void) {
     }
 
     State = 2;
+    IPTimerCancel(&BufferAlarm);
     __IPWakeupPollingThreads();
+    for (s = 0; s < SO_EPOLL_NUM; s++) {
+        if (EpollTable[s].used) {
+            OSWakeupThread(&EpollTable[s].queueThread);
+        }
+    }
 
     for (s = 0; s < SO_TABLE_NUM; s++) {
         node = &SocketTable[s];
@@ -503,6 +973,7 @@ int SOCleanup(void) {
         }
 
         if (TimeWaitBuf != NULL) {
+            TCPSetTimeWaitTable(NULL, 0);
             SOFree(6, TimeWaitBuf, TimeWaitBufSize);
         }
 
@@ -566,15 +1037,17 @@ int SOSocket(int af, int type, int protocol) {
     }
 
     GetNode(-1, NULL);
+    if (type == 1 && SOGetMemoryPressure() != 0) {
+        return -42;
+    }
+
     node = NULL;
     enabled = OSDisableInterrupts();
-    for (socket = 0; socket < SO_TABLE_NUM; socket++) {
+    socket = FindFreeNode(GetThreadShard());
+    if (socket >= 0) {
         node = &SocketTable[socket];
-        if (node->ref == 0) {
-            ASSERTLINE(1087, node->info == NULL);
-            node->ref = 2;
-            break;
-        }
+        ASSERTLINE(1087, node->info == NULL);
+        node->ref = 2;
     }
     OSRestoreInterrupts(enabled);
 
@@ -586,11 +1059,28 @@ int SOSocket(int af, int type, int protocol) {
     switch (type) {
         case 1:
             tcp = (TCPInfo*)SOAlloc(0, sizeof(TCPInfo));
-            sendbuf = SOAlloc(1, rwin);
-            recvbuf = SOAlloc(2, rwin);
+            sendbuf = AllocBuffer(1, rwin);
+            recvbuf = AllocBuffer(2, rwin);
             rc = TCPOpen(tcp, sendbuf, rwin, recvbuf, rwin);
             if (rc >= 0) {
                 TCPSetTimeout(tcp, R2);
+                tcp->cc = NULL;
+                TCPSetCongestion(tcp, NULL);
+                tcp->paceNext = 0;
+                tcp->paceQueued = FALSE;
+                tcp->paceMaxRate = 0;
+                tcp->sackList.next = tcp->sackList.prev = NULL;
+                tcp->sackBytes = tcp->sackCount = 0;
+                tcp->rackList.next = tcp->rackList.prev = NULL;
+                tcp->rackXmit = 0;
+                tcp->rackLost = 0;
+                tcp->rackTimer = TCP_RACK_TIMER_NONE;
+                tcp->tlpPending = FALSE;
+                IPTimerCreate(&tcp->rackAlarm);
+                IPTimerCreate(&tcp->lingerAlarm);
+                TCPOptInit(tcp);
+                TCPAckInit(tcp);
+                TCPSackInitRecv(tcp);
             }
             break;
         case 2:
@@ -612,8 +1102,8 @@ int SOSocket(int af, int type, int protocol) {
         switch (type) {
             case 1:
                 SOFree(0, tcp, sizeof(TCPInfo));
-                SOFree(1, sendbuf, rwin);
-                SOFree(2, recvbuf, rwin);
+                PutBuffer(1, sendbuf, rwin);
+                PutBuffer(2, recvbuf, rwin);
                 break;
             case 2:
                 SOFree(3, tcp, sizeof(TCPInfo));
@@ -650,6 +1140,7 @@ int SOSocket(int af, int type, int protocol) {
 static void LingerCallback(TCPInfo* info) {
     SONode* node;
 
+    IPTimerCancel(&info->lingerAlarm);
     node = (SONode*)info->node;
     if (node != NULL) {
         ASSERTLINE(1178, 0 < node->ref);
@@ -659,13 +1150,24 @@ static void LingerCallback(TCPInfo* info) {
     IFQueueDequeueTail(IPInfo*, &LingerQueue, info);
 }
 
-static void LingerTimeout(OSAlarm* alarm) {
+static void LingerTimeout(IPTimer* alarm) {
     TCPInfo* tcp;
 
     tcp = (TCPInfo*)(((u8*)alarm) - offsetof(TCPInfo, lingerAlarm));
     TCPCancel(tcp);
 }
 
+/* Closing first from ESTABLISHED leaves this end in TIME_WAIT once the
+ * FIN handshake completes, so IPConnect keeps off the tuple from now */
+static void EnterTimeWait(TCPInfo* tcp) {
+    IPInfo* info;
+
+    info = &tcp->pair;
+    if (TCPGetStatus(tcp) == TCP_STATE_ESTABLISHED) {
+        TCPEnterTimeWait(info->remote.addr, info->remote.port, info->local.addr, info->local.port);
+    }
+}
+
 static int __SOClose(int s) {
     SONode* node;
     IPInfo* info;
@@ -684,6 +1186,8 @@ static int __SOClose(int s) {
     }
 
     ASSERTLINE(1211, 0 < node->ref);
+    RemoveEpollItems(info);
+    CancelAsync(s);
     switch (node->proto) {
         case IP_PROTO_UDP:
             rc = UDPClose(info);
@@ -717,6 +1221,7 @@ static int __SOClose(int s) {
                 rc = TCPCancel(tcp);
                 ASSERTLINE(1252, TCPGetStatus(tcp) != TCP_STATE_LISTEN);
                 if (tcp->accepting > 0) {
+                    WakeupAll(&AsyncTable[s].queueWaiter);
                     OSWakeupThread(&tcp->queueThread);
                 }
                 node->ref--;
@@ -727,13 +1232,15 @@ static int __SOClose(int s) {
                 if (linger.linger <= 0) {
                     rc = TCPCancel(tcp);
                 } else {
-                    OSSetAlarm(&tcp->lingerAlarm, OSSecondsToTicks(linger.linger), &LingerTimeout);
+                    EnterTimeWait(tcp);
+                    IPTimerSet(&tcp->lingerAlarm, OSSecondsToTicks(linger.linger), LingerTimeout);
                     rc = TCPClose(tcp);
                 }
 
                 node->ref--;
             } else {
-                OSSetAlarm(&tcp->lingerAlarm, OSSecondsToTicks(15), &LingerTimeout);
+                EnterTimeWait(tcp);
+                IPTimerSet(&tcp->lingerAlarm, OSSecondsToTicks(15), LingerTimeout);
                 rc = TCPCloseAsync(tcp, &LingerCallback, 0);
                 if (node->ref == 2) {
                     tcp->node = NULL;
@@ -746,8 +1253,7 @@ static int __SOClose(int s) {
 
             while (queue.next != NULL) {
                 IFQueueDequeueHeadLINK(TCPInfo*, &queue, linkLog, log);
-                SOFree(2, log->recvData, log->recvBuff);
-                SOFree(1, log->sendData, log->sendBuff);
+                FreeBuffers(log);
                 SOFree(0, log, sizeof(TCPInfo));
 
             }
@@ -784,7 +1290,14 @@ static void AcceptCallback(TCPInfo* tcp, s32 result) {
         if (result >= 0) {
             IFQueueDequeueEntryLINK(TCPInfo*, &logging->queueBacklog, linkLog, tcp);
             IFQueueEnqueueTailLINK(TCPInfo*, &logging->queueCompleted, linkLog, tcp);
+            if (logging->node != NULL) {
+                CompleteAcceptAsync((SONode*)logging->node, logging);
+                if (logging->queueCompleted.next != NULL) {
+                    WakeupOne(&AsyncTable[(SONode*)logging->node - SocketTable].queueWaiter);
+                }
+            }
             OSWakeupThread(&logging->queueThread);
+            __SONotify(&logging->pair);
             if (logging->pair.poll > 0) {
                 __IPWakeupPollingThreads();
             }
@@ -806,18 +1319,42 @@ static TCPInfo* AddBackLog(TCPInfo* listening) {
     s32 sendbufLen;
     void* recvbuf;
     s32 recvbufLen;
+    IFBlock* blocks;
     s32 rc;
     BOOL enabled;
     
     ASSERTLINE(1423, listening);
+    if (SOGetMemoryPressure() != 0) {
+        return NULL;
+    }
+
     tcp = (TCPInfo*)SOAlloc(0, sizeof(TCPInfo));
     sendbufLen = listening->sendBuff;
     recvbufLen = listening->recvBuff;
-    sendbuf = SOAlloc(1, sendbufLen);
-    recvbuf = SOAlloc(2, recvbufLen);
+    sendbuf = AllocBuffer(1, sendbufLen);
+    recvbuf = AllocBuffer(2, recvbufLen);
     rc = TCPOpen(tcp, sendbuf, sendbufLen, recvbuf, recvbufLen);
     if (rc >= 0) {
         TCPSetTimeout(tcp, R2);
+        tcp->cc = NULL;
+        TCPSetCongestion(tcp, listening->cc);
+        tcp->paceNext = 0;
+        tcp->paceQueued = FALSE;
+        tcp->paceMaxRate = listening->paceMaxRate;
+        tcp->sackList.next = tcp->sackList.prev = NULL;
+        tcp->sackBytes = tcp->sackCount = 0;
+        tcp->rackList.next = tcp->rackList.prev = NULL;
+        tcp->rackXmit = 0;
+        tcp->rackLost = 0;
+        tcp->rackTimer = TCP_RACK_TIMER_NONE;
+        tcp->tlpPending = FALSE;
+        IPTimerCreate(&tcp->rackAlarm);
+        IPTimerCreate(&tcp->lingerAlarm);
+        TCPOptInit(tcp);
+        TCPAckInit(tcp);
+        tcp->ackEvery = listening->ackEvery;
+        TCPSackInitRecv(tcp);
+        tcp->node = NULL;
         enabled = OSDisableInterrupts();
 
         if (TCPGetStatus(listening) == TCP_STATE_LISTEN) {
@@ -832,8 +1369,8 @@ static TCPInfo* AddBackLog(TCPInfo* listening) {
         OSRestoreInterrupts(enabled);
     }
 
-    SOFree(2, recvbuf, recvbufLen);
-    SOFree(1, sendbuf, sendbufLen);
+    PutBuffer(2, recvbuf, recvbufLen);
+    PutBuffer(1, sendbuf, sendbufLen);
     SOFree(0, tcp, sizeof(TCPInfo));
     return NULL;
 }
@@ -893,16 +1430,62 @@ int SOListen(int s, int backlog) {
     return rc;
 }
 
+/* Must be called with interrupts disabled. Returns the new descriptor, -6 if
+ * the completed connection was unusable and went back to the backlog, or -33
+ * if the socket table is full. */
+static int TakeCompleted(SONode* node, TCPInfo* listening, void* sockAddr, int shard) {
+    SONode* connected;
+    TCPInfo* tcp;
+    int socket;
+    s32 rc;
+    s32 state;
+
+    socket = FindFreeNode(shard);
+    if (socket < 0) {
+        return -33;
+    }
+
+    connected = &SocketTable[socket];
+    IFQueueDequeueHeadLINK(TCPInfo*, &listening->queueCompleted, linkLog, tcp);
+    ASSERTLINE(1641, tcp);
+    rc = 0;
+    if (sockAddr != NULL) {
+        rc = TCPGetRemoteSocket(tcp, (IPSocket*)sockAddr);
+    }
+
+    state = TCPGetStatus(tcp);
+    /* A Fast Open child is handed over in SYN_RECEIVED */
+    if ((state != 4 && state != 7 && state != TCP_STATE_SYN_RECEIVED) || rc < 0) {
+        TCPCancel(tcp);
+        TCPOpen(tcp, tcp->sendData, tcp->sendBuff, tcp->recvData, tcp->recvBuff);
+        TCPSetTimeout(tcp, R2);
+        tcp->logging = listening;
+        IFQueueEnqueueTailLINK(TCPInfo*, &listening->queueBacklog, linkLog, tcp);
+        TCPAcceptAsync(tcp, listening, &AcceptCallback, 0);
+        return -6;
+    }
+
+    if (listening->queueCompleted.next != NULL) {
+        __SONotify(&listening->pair);
+    }
+
+    connected->flag = node->flag;
+    connected->ref = 1;
+    OSInitMutex(&connected->mutexRead);
+    OSInitMutex(&connected->mutexWrite);
+    connected->proto = IP_PROTO_TCP;
+    connected->info = (IPInfo*)tcp;
+    tcp->node = connected;
+    return socket;
+}
+
 int SOAccept(int s, void* sockAddr) {
     BOOL enabled;
     SONode* node;
     IPInfo* info;
     TCPInfo* listening;
-    TCPInfo* tcp;
-    int socket;
+    SOWaiter waiter;
     s32 rc;
-    s32 state;
-    SONode* connected;
 
     if (State != 1) {
         return -39;
@@ -929,57 +1512,39 @@ int SOAccept(int s, void* sockAddr) {
             }
 
             listening->accepting++;
+            rc = 0;
             while (TCPGetStatus(listening) == TCP_STATE_LISTEN && listening->queueCompleted.next == NULL) {
                 if ((node->flag & 0x4) != 0) {
-                    listening->accepting--;
                     rc = -6;
                     break;
                 }
 
-                OSSleepThread(&listening->queueThread);
+                SleepExclusive(&AsyncTable[s].queueWaiter, &waiter);
             }
 
             listening->accepting--;
+            if (rc == -6) {
+                break;
+            }
             if (TCPGetStatus(listening) != TCP_STATE_LISTEN) {
                 rc = -13;
                 break;
             }
 
-            for (socket = 0; socket < SO_TABLE_NUM; socket++) {
-                connected = &SocketTable[socket];
-                if (connected->ref == 0) {
-                    IFQueueDequeueHeadLINK(TCPInfo*, &listening->queueCompleted, linkLog, tcp);
-                    ASSERTLINE(1641, tcp);
-                    rc = 0;
-                    if (sockAddr != NULL) {
-                        rc = TCPGetRemoteSocket(tcp, (IPSocket*)sockAddr);
-                    }
+            rc = TakeCompleted(node, listening, sockAddr, GetThreadShard());
+            if (rc == -6) {
+                goto tcp_accept_loop;
+            }
 
-                    state = TCPGetStatus(tcp);
-                    if ((state != 4 && state != 7) || rc < 0) {
-                        TCPCancel(tcp);
-                        TCPOpen(tcp, tcp->sendData, tcp->sendBuff, tcp->recvData, tcp->recvBuff);
-                        TCPSetTimeout(tcp, R2);
-                        tcp->logging = listening;
-                        IFQueueEnqueueTailLINK(TCPInfo*, &listening->queueBacklog, linkLog, tcp);
-                        TCPAcceptAsync(tcp, listening, &AcceptCallback, 0);
-                        goto tcp_accept_loop;
-                    } else {
-                        connected->flag = node->flag;
-                        connected->ref = 1;
-                        OSInitMutex(&connected->mutexRead);
-                        OSInitMutex(&connected->mutexWrite);
-                        connected->proto = IP_PROTO_TCP;
-                        connected->info = (IPInfo*)tcp;
-                        OSRestoreInterrupts(enabled);
-                        AddBackLog(listening);
-                        break;
-                    }
-                }
+            if (rc < 0 && listening->queueCompleted.next != NULL) {
+                /* Hand the connection we were woken for to the next waiter */
+                WakeupOne(&AsyncTable[s].queueWaiter);
             }
 
-            if (socket >= SO_TABLE_NUM) {
-                rc = -33;
+            if (rc >= 0) {
+                rc = 0;
+                OSRestoreInterrupts(enabled);
+                AddBackLog(listening);
             }
             break;
         default:
@@ -1040,6 +1605,33 @@ int SOBind(int s, void* sockAddr) {
     }
 }
 
+static int GetConnectError(s32 rc) {
+    switch (rc) {
+        case 0:
+            return 0;
+        case -1:
+            return -26;
+        case -13:
+            return -5;
+        case -5:
+            return -30;
+        case -3:
+            return -15;
+        case -11:
+            return -14;
+        case -10:
+            return -76;
+        case -12:
+            return -28;
+        case -7:
+            return -42;
+        case -19:
+            return -38;
+        default:
+            return -40;
+    }
+}
+
 int SOConnect(int s, void* sockAddr) {
     SONode* node;
     IPInfo* info;
@@ -1086,30 +1678,74 @@ int SOConnect(int s, void* sockAddr) {
     }
 
     PutNode(node);
-    switch (rc) {
-        case 0:
-            return 0;
-        case -1:
-            return -26;
-        case -13:
-            return -5;
-        case -5:
-            return -30;
-        case -3:
-            return -15;
-        case -11:
-            return -14;
-        case -10:
-            return -76;
-        case -12:
-            return -28;
-        case -7:
-            return -42;
-        case -19:
-            return -38;
-        default:
-            return -40;
+    return GetConnectError(rc);
+}
+
+/* Connects a TCP socket with up to len bytes of buf queued to be sent as
+ * soon as the handshake completes, saving the caller a SOSend after
+ * connecting. The data does not travel in the SYN: TCPOut in the TCP core
+ * does not build Fast Open SYNs yet. Returns the number of bytes queued,
+ * also while a non-blocking connect is still in progress, or a negative
+ * error, in which case nothing stays queued. */
+int SOConnectData(int s, void* sockAddr, const void* buf, int len) {
+    BOOL enabled;
+    SONode* node;
+    IPInfo* info;
+    TCPInfo* tcp;
+    s32 rc;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    if (sockAddr == NULL || ((SOSockAddr*)sockAddr)->len < sizeof(SOSockAddrIn) || len < 0) {
+        return -28;
+    }
+
+    node = GetNode(s, &info);
+    if (node == NULL || info == NULL) {
+        return -8;
+    }
+
+    if (info->proto != IP_PROTO_TCP) {
+        PutNode(node);
+        return -63;
+    }
+
+    tcp = (TCPInfo*)info;
+    if (0 < len && !__SOAttachSendBuffer(tcp)) {
+        PutNode(node);
+        return -42;
+    }
+
+    enabled = OSDisableInterrupts();
+    if (tcp->sendBuff - tcp->sendLen < len) {
+        len = tcp->sendBuff - tcp->sendLen;
+    }
+    if (0 < len) {
+        IFRingIn(tcp->sendData, tcp->sendBuff, tcp->sendPtr, tcp->sendLen, (const u8*)buf, len);
+        tcp->sendLen += len;
     }
+    OSRestoreInterrupts(enabled);
+
+    if ((node->flag & 0x4) == 0) {
+        rc = TCPConnect(tcp, (IPSocket*)sockAddr);
+    } else {
+        rc = TCPConnectAsync(tcp, (IPSocket*)sockAddr, NULL, 0);
+        if (rc == 0 && tcp->openCallback != NULL) {
+            rc = -1;
+        }
+    }
+
+    if (rc != 0 && rc != -1 && 0 < len) {
+        /* Nothing was sent; take the data back off the ring */
+        enabled = OSDisableInterrupts();
+        tcp->sendLen -= len;
+        OSRestoreInterrupts(enabled);
+    }
+
+    PutNode(node);
+    return (rc == 0 || rc == -1) ? len : GetConnectError(rc);
 }
 
 int SOGetPeerName(int s, void* sockAddr) {
@@ -1203,3 +1839,1282 @@ int SOGetSockName(int s, void* sockAddr) {
 
     return 0;
 }
+
+/* Returns the distance of ptr from head in a ring of the given size */
+static s32 GetRingOffset(u8* buf, s32 size, u8* head, u8* ptr) {
+    s32 offset;
+
+    offset = (s32)ptr - (s32)head;
+    if (offset < 0) {
+        offset += size;
+    }
+    return offset;
+}
+
+/* Copies the ring contents to the front of buf, moves the out-of-order
+ * blocks along with them and swaps the ring in. Must be called with
+ * interrupts disabled. */
+static s32 MoveRecvRing(TCPInfo* tcp, u8* buf, s32 size) {
+    u8* old;
+    s32 oldSize;
+    s32 extent;
+    s32 offset;
+    int i;
+
+    old = tcp->recvData;
+    oldSize = tcp->recvBuff;
+    if (old == NULL) {
+        tcp->recvData = tcp->recvPtr = buf;
+        tcp->recvBuff = size;
+        return 0;
+    }
+
+    extent = tcp->recvUser;
+    for (i = 0; i < TCP_SACK_ASB_NUM && tcp->asb[i].ptr != NULL; i++) {
+        offset = GetRingOffset(old, oldSize, tcp->recvPtr, tcp->asb[i].ptr);
+        if (extent < offset + tcp->asb[i].len) {
+            extent = offset + tcp->asb[i].len;
+        }
+    }
+
+    if (buf == NULL) {
+        return -6;
+    }
+
+    if (size < extent) {
+        return -28;
+    }
+
+    for (i = 0; i < TCP_SACK_ASB_NUM && tcp->asb[i].ptr != NULL; i++) {
+        offset = GetRingOffset(old, oldSize, tcp->recvPtr, tcp->asb[i].ptr);
+        IFRingOut(old, oldSize, tcp->asb[i].ptr, tcp->asb[i].len, buf + offset, tcp->asb[i].len);
+        tcp->asb[i].ptr = buf + offset;
+    }
+
+    if (old <= tcp->segBegin && tcp->segBegin < old + oldSize) {
+        tcp->segBegin = buf + GetRingOffset(old, oldSize, tcp->recvPtr, tcp->segBegin);
+    }
+
+    if (tcp->recvUser != 0) {
+        IFRingOut(old, oldSize, tcp->recvPtr, tcp->recvUser, buf, tcp->recvUser);
+    }
+
+    tcp->recvData = tcp->recvPtr = buf;
+    tcp->recvBuff = size;
+    if (size - tcp->recvUser < tcp->recvWin) {
+        tcp->recvWin = size - tcp->recvUser;
+    }
+    return 0;
+}
+
+static s32 MoveSendRing(TCPInfo* tcp, u8* buf, s32 size) {
+    if (tcp->sendData == NULL) {
+        tcp->sendData = tcp->sendPtr = buf;
+        tcp->sendBuff = size;
+        return 0;
+    }
+
+    if (tcp->sendBusy || buf == NULL) {
+        return -6;
+    }
+
+    if (size < tcp->sendLen) {
+        return -28;
+    }
+
+    if (tcp->sendLen != 0) {
+        IFRingOut(tcp->sendData, tcp->sendBuff, tcp->sendPtr, tcp->sendLen, buf, tcp->sendLen);
+    }
+
+    tcp->sendData = tcp->sendPtr = buf;
+    tcp->sendBuff = size;
+    return 0;
+}
+
+static s32 ResizeTCPBuffer(TCPInfo* tcp, int optname, s32 size) {
+    BOOL enabled;
+    u32 name;
+    u8* buf;
+    u8* old;
+    s32 oldSize;
+    s32 rc;
+
+    name = (optname == SO_SNDBUF) ? 1 : 2;
+    old = (optname == SO_SNDBUF) ? tcp->sendData : tcp->recvData;
+    buf = NULL;
+    if (old != NULL || size != BufferSize) {
+        buf = (u8*)GetBuffer(name, size, TRUE);
+        if (buf == NULL) {
+            return -49;
+        }
+    }
+
+    enabled = OSDisableInterrupts();
+    if (optname == SO_SNDBUF) {
+        old = tcp->sendData;
+        oldSize = tcp->sendBuff;
+        rc = MoveSendRing(tcp, buf, size);
+    } else {
+        old = tcp->recvData;
+        oldSize = tcp->recvBuff;
+        rc = MoveRecvRing(tcp, buf, size);
+    }
+    OSRestoreInterrupts(enabled);
+
+    if (0 <= rc) {
+        __SONotify(&tcp->pair);
+    }
+
+    if (rc < 0) {
+        PutBuffer(name, buf, size);
+    } else {
+        PutBuffer(name, old, oldSize);
+    }
+    return rc;
+}
+
+static s32 ResizeUDPBuffer(UDPInfo* udp, int optname, s32 size) {
+    BOOL enabled;
+    u8* buf;
+    u8* old;
+    s32 oldSize;
+    s32 rc;
+
+    buf = (u8*)SOAlloc(optname == SO_SNDBUF ? 4 : 5, size);
+    if (buf == NULL) {
+        return -49;
+    }
+
+    rc = 0;
+    enabled = OSDisableInterrupts();
+    if (optname == SO_SNDBUF) {
+        old = udp->sendData;
+        oldSize = udp->sendBuff;
+        if (udp->sendUsed != 0) {
+            rc = -6;
+        } else {
+            rc = UDPSetSendBuff(udp, buf, size);
+        }
+    } else {
+        old = udp->recvRing;
+        oldSize = udp->recvBuff;
+        if (size < udp->recvUsed) {
+            rc = -28;
+        } else {
+            if (udp->recvUsed != 0) {
+                IFRingOut(old, oldSize, udp->recvPtr, udp->recvUsed, buf, udp->recvUsed);
+            }
+            udp->recvRing = udp->recvPtr = buf;
+            udp->recvBuff = size;
+        }
+    }
+    OSRestoreInterrupts(enabled);
+
+    if (rc < 0) {
+        SOFree(optname == SO_SNDBUF ? 4 : 5, buf, size);
+        return rc;
+    }
+
+    SOFree(optname == SO_SNDBUF ? 4 : 5, old, oldSize);
+    return 0;
+}
+
+/* Resizes a socket's send or receive buffer, carrying over any queued data.
+ * Returns -28 if the data already queued does not fit the new size and -6
+ * if a TCP segment is being transmitted from the send ring. */
+int SOSetBufferSize(int s, int optname, int size) {
+    SONode* node;
+    IPInfo* info;
+    s32 rc;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    if (optname != SO_SNDBUF && optname != SO_RCVBUF) {
+        return -28;
+    }
+
+    if (size < SO_BUF_MIN) {
+        size = SO_BUF_MIN;
+    } else if (SO_BUF_MAX < size) {
+        size = SO_BUF_MAX;
+    }
+
+    node = GetNode(s, &info);
+    if (node == NULL || info == NULL) {
+        return -8;
+    }
+
+    OSLockMutex(&node->mutexRead);
+    OSLockMutex(&node->mutexWrite);
+    switch (info->proto) {
+        case IP_PROTO_TCP:
+            if (SOGetMemoryPressure() != 0 && (optname == SO_SNDBUF ? ((TCPInfo*)info)->sendBuff : ((TCPInfo*)info)->recvBuff) < size) {
+                rc = -42;
+                break;
+            }
+            rc = ResizeTCPBuffer((TCPInfo*)info, optname, size);
+            if (rc == 0 && optname == SO_RCVBUF) {
+                TuneTable[s].locked = TRUE;
+            }
+            break;
+        case IP_PROTO_UDP:
+            rc = ResizeUDPBuffer((UDPInfo*)info, optname, size);
+            break;
+        default:
+            rc = -8;
+            break;
+    }
+    OSUnlockMutex(&node->mutexWrite);
+    OSUnlockMutex(&node->mutexRead);
+
+    PutNode(node);
+    return rc;
+}
+
+int SOGetBufferSize(int s, int optname) {
+    SONode* node;
+    IPInfo* info;
+    s32 rc;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    if (optname != SO_SNDBUF && optname != SO_RCVBUF) {
+        return -28;
+    }
+
+    node = GetNode(s, &info);
+    if (node == NULL || info == NULL) {
+        return -8;
+    }
+
+    switch (info->proto) {
+        case IP_PROTO_TCP:
+            rc = (optname == SO_SNDBUF) ? ((TCPInfo*)info)->sendBuff : ((TCPInfo*)info)->recvBuff;
+            break;
+        case IP_PROTO_UDP:
+            rc = (optname == SO_SNDBUF) ? ((UDPInfo*)info)->sendBuff : ((UDPInfo*)info)->recvBuff;
+            break;
+        default:
+            rc = -8;
+            break;
+    }
+
+    PutNode(node);
+    return rc;
+}
+
+/* Receive-buffer autotuning. Each time the application asks a connection
+ * for more data at least one srtt after the last sample, the bytes it
+ * consumed in between, scaled to one srtt, give the drain rate per round
+ * trip. The receive ring is grown to twice that, so the advertised window
+ * never limits a reader that keeps up, within TuneSocketMax per socket and
+ * TuneTotalMax bytes of growth overall. Sockets sized with
+ * SOSetBufferSize(SO_RCVBUF) are left alone. */
+static void TuneRecvBuffer(int s, SONode* node, TCPInfo* tcp) {
+    SOTuneSlot* slot;
+    BOOL enabled;
+    OSTime now;
+    s32 copied;
+    s32 size;
+    s32 old;
+
+    slot = &TuneTable[s];
+    now = OSGetTime();
+    if (slot->tcp != tcp) {
+        ReleaseTune(s);
+        slot->tcp = tcp;
+        slot->seq = tcp->recvNext - tcp->recvUser;
+        slot->time = now;
+        slot->locked = FALSE;
+        return;
+    }
+
+    if (slot->locked || TCPGetStatus(tcp) != TCP_STATE_ESTABLISHED || tcp->srtt <= 0 || now - slot->time < tcp->srtt) {
+        return;
+    }
+
+    copied = tcp->recvNext - tcp->recvUser - slot->seq;
+    slot->seq += copied;
+    copied = (s32)(copied * tcp->srtt / (now - slot->time));
+    slot->time = now;
+
+    /* ReleaseRecvBuffers gives back the growth */
+    if (SOGetMemoryPressure() != 0) {
+        return;
+    }
+
+    size = 2 * copied;
+    if (TuneSocketMax < size) {
+        size = TuneSocketMax;
+    }
+
+    /* Without window scaling a larger ring could not be advertised */
+    if (TCPOptGetMaxWindow(tcp) < size) {
+        size = TCPOptGetMaxWindow(tcp);
+    }
+
+    old = tcp->recvBuff;
+    if (TuneTotalMax - TuneTotal < size - old) {
+        size = old + TuneTotalMax - TuneTotal;
+    }
+
+    if (size <= old || !OSTryLockMutex(&node->mutexRead)) {
+        return;
+    }
+
+    if (ResizeTCPBuffer(tcp, SO_RCVBUF, size) == 0) {
+        enabled = OSDisableInterrupts();
+        TuneTotal += tcp->recvBuff - old;
+        slot->grown += tcp->recvBuff - old;
+        OSRestoreInterrupts(enabled);
+    }
+    OSUnlockMutex(&node->mutexRead);
+}
+
+/* Called by the receive paths before they take more data (SORecvAsync and
+ * the blocking receive in the TCP core), from thread context and with a
+ * reference on the socket held */
+void __SOTuneRecvBuffer(TCPInfo* tcp) {
+    SONode* node;
+
+    node = (SONode*)tcp->node;
+    if (node != NULL && State == 1) {
+        TuneRecvBuffer(node - SocketTable, node, tcp);
+    }
+}
+
+static void ReleaseTune(int s) {
+    BOOL enabled;
+    SOTuneSlot* slot;
+
+    slot = &TuneTable[s];
+    enabled = OSDisableInterrupts();
+    TuneTotal -= slot->grown;
+    slot->grown = 0;
+    slot->tcp = NULL;
+    OSRestoreInterrupts(enabled);
+}
+
+/* Sets the autotuning limits; a socketMax of 0 turns autotuning off */
+void SOSetAutoTuneLimit(int socketMax, int totalMax) {
+    TuneSocketMax = (SO_BUF_MAX < socketMax) ? SO_BUF_MAX : socketMax;
+    TuneTotalMax = totalMax;
+}
+
+/* Selects the congestion control algorithm (TCP_CC_RENO, TCP_CC_CUBIC or
+ * TCP_CC_BBR) of a TCP socket. Returns -63 for now: TCPIn and the
+ * retransmit timer in the TCP core still run their own congestion control
+ * and do not call the TCPCongestion hooks, so a selected algorithm would
+ * never run. */
+int SOSetCongestionControl(int s, int algorithm) {
+    SONode* node;
+    IPInfo* info;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    if (algorithm < 0 || TCP_CC_NUM <= algorithm) {
+        return -28;
+    }
+
+    node = GetNode(s, &info);
+    if (node == NULL || info == NULL) {
+        return -8;
+    }
+
+    PutNode(node);
+    return -63;
+}
+
+/* Caps the pacing rate of a TCP socket in bytes per second; 0 removes the
+ * cap. Returns -63 for now: TCPOut in the TCP core does not call
+ * TCPPaceCheck and TCPPaceSent, so connections are not paced. */
+int SOSetMaxPacingRate(int s, int rate) {
+    SONode* node;
+    IPInfo* info;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    if (rate < 0) {
+        return -28;
+    }
+
+    node = GetNode(s, &info);
+    if (node == NULL || info == NULL) {
+        return -8;
+    }
+
+    PutNode(node);
+    return -63;
+}
+
+/* Sets the delayed-ACK policy of a TCP socket: ACK every Nth full-sized
+ * segment during bulk receive (default TCP_ACK_EVERY), or with 0 ACK every
+ * segment at once. Returns -63 for now: TCPIn in the TCP core still decides
+ * on delayed ACKs itself and does not consult TCPAckNow. */
+int SOSetAckPolicy(int s, int every) {
+    SONode* node;
+    IPInfo* info;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    if (every < 0 || TCP_ACK_EVERY_MAX < every) {
+        return -28;
+    }
+
+    node = GetNode(s, &info);
+    if (node == NULL || info == NULL) {
+        return -8;
+    }
+
+    PutNode(node);
+    return -63;
+}
+
+/* Lets a listening TCP socket issue Fast Open cookies and accept data in
+ * SYNs that carry a valid one. Returns -63 for now: TCPIn in the TCP core
+ * does not check Fast Open cookies, and there is no way to hand it a
+ * connection set up from a SYN outside it. */
+int SOSetFastOpen(int s, BOOL enable) {
+    SONode* node;
+    IPInfo* info;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    node = GetNode(s, &info);
+    if (node == NULL || info == NULL) {
+        return -8;
+    }
+
+    PutNode(node);
+    return -63;
+}
+
+static s16 GetEvents(IPInfo* info) {
+    TCPInfo* tcp;
+    UDPInfo* udp;
+    s32 state;
+    s16 events;
+
+    events = 0;
+    switch (info->proto) {
+        case IP_PROTO_TCP:
+            tcp = (TCPInfo*)info;
+            state = TCPGetStatus(tcp);
+            if (state == TCP_STATE_LISTEN) {
+                if (tcp->queueCompleted.next != NULL) {
+                    events |= SO_POLLRDNORM;
+                }
+                break;
+            }
+
+            if (tcp->recvUser > 0 || state == 7) {
+                events |= SO_POLLRDNORM;
+            }
+
+            if (tcp->recvUrg > 0) {
+                events |= SO_POLLRDBAND;
+            }
+
+            if ((state == 4 || state == 7) && tcp->sendLen < tcp->sendBuff) {
+                events |= SO_POLLWRNORM;
+            }
+
+            if (tcp->err < 0) {
+                events |= SO_POLLERR;
+            }
+
+            if (state == 0) {
+                events |= SO_POLLHUP;
+            }
+            break;
+        case IP_PROTO_UDP:
+            udp = (UDPInfo*)info;
+            if (udp->recvUsed > 0) {
+                events |= SO_POLLRDNORM;
+            }
+
+            if (udp->sendUsed < udp->sendBuff) {
+                events |= SO_POLLWRNORM;
+            }
+            break;
+    }
+
+    return events;
+}
+
+static SOEpoll* GetEpoll(int ep) {
+    if (ep < 0 || SO_EPOLL_NUM <= ep || !EpollTable[ep].used) {
+        return NULL;
+    }
+
+    return &EpollTable[ep];
+}
+
+static SOEpollItem* LookupEpollItem(SOEpoll* set, IPInfo* info) {
+    SOEpollItem* item;
+    SOEpollItem* next;
+
+    for (item = (SOEpollItem*)EpollHash[SO_EPOLL_HASH(info)].next; item != NULL; item = next) {
+        next = (SOEpollItem*)item->linkHash.next;
+        if (item->set == set && item->info == info) {
+            return item;
+        }
+    }
+
+    return NULL;
+}
+
+/* Must be called with interrupts disabled */
+static void UnlinkEpollItem(SOEpollItem* item) {
+    IFQueueDequeueEntryLINK(SOEpollItem*, &EpollHash[SO_EPOLL_HASH(item->info)], linkHash, item);
+    if (item->ready) {
+        IFQueueDequeueEntry(SOEpollItem*, &item->set->queueReady, item);
+        item->ready = FALSE;
+    }
+
+    item->set->count--;
+}
+
+static void RemoveEpollItems(IPInfo* info) {
+    SOEpollItem* item;
+    SOEpollItem* next;
+    IFQueue queue;
+    BOOL enabled;
+
+    queue.next = queue.prev = NULL;
+    enabled = OSDisableInterrupts();
+    for (item = (SOEpollItem*)EpollHash[SO_EPOLL_HASH(info)].next; item != NULL; item = next) {
+        next = (SOEpollItem*)item->linkHash.next;
+        if (item->info == info) {
+            UnlinkEpollItem(item);
+            IFQueueEnqueueTail(SOEpollItem*, &queue, item);
+        }
+    }
+    OSRestoreInterrupts(enabled);
+
+    while (queue.next != NULL) {
+        IFQueueDequeueHead(SOEpollItem*, &queue, item);
+        SOFree(8, item, sizeof(SOEpollItem));
+    }
+}
+
+void __SONotify(IPInfo* info) {
+    SOEpollItem* item;
+    SOEpollItem* next;
+    BOOL enabled;
+    s16 events;
+
+    enabled = OSDisableInterrupts();
+    item = (SOEpollItem*)EpollHash[SO_EPOLL_HASH(info)].next;
+    if (item != NULL) {
+        events = GetEvents(info);
+        for (; item != NULL; item = next) {
+            next = (SOEpollItem*)item->linkHash.next;
+            if (item->info == info && !item->ready && (events & (item->events | SO_POLLERR | SO_POLLHUP)) != 0) {
+                item->ready = TRUE;
+                IFQueueEnqueueTail(SOEpollItem*, &item->set->queueReady, item);
+                OSWakeupThread(&item->set->queueThread);
+            }
+        }
+    }
+    OSRestoreInterrupts(enabled);
+}
+
+int SOEpollCreate(void) {
+    BOOL enabled;
+    SOEpoll* set;
+    int ep;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    enabled = OSDisableInterrupts();
+    for (ep = 0; ep < SO_EPOLL_NUM; ep++) {
+        set = &EpollTable[ep];
+        if (!set->used) {
+            set->used = TRUE;
+            set->count = 0;
+            IFQueueInit(&set->queueReady);
+            OSInitThreadQueue(&set->queueThread);
+            break;
+        }
+    }
+    OSRestoreInterrupts(enabled);
+
+    if (ep >= SO_EPOLL_NUM) {
+        return -33;
+    }
+
+    return ep;
+}
+
+int SOEpollClose(int ep) {
+    BOOL enabled;
+    SOEpoll* set;
+    SOEpollItem* item;
+    SOEpollItem* next;
+    IFQueue queue;
+    int i;
+
+    queue.next = queue.prev = NULL;
+    enabled = OSDisableInterrupts();
+    set = GetEpoll(ep);
+    if (set == NULL) {
+        OSRestoreInterrupts(enabled);
+        return -8;
+    }
+
+    for (i = 0; i < SO_EPOLL_HASH_NUM && set->count > 0; i++) {
+        for (item = (SOEpollItem*)EpollHash[i].next; item != NULL; item = next) {
+            next = (SOEpollItem*)item->linkHash.next;
+            if (item->set == set) {
+                UnlinkEpollItem(item);
+                IFQueueEnqueueTail(SOEpollItem*, &queue, item);
+            }
+        }
+    }
+
+    set->used = FALSE;
+    OSWakeupThread(&set->queueThread);
+    OSRestoreInterrupts(enabled);
+
+    while (queue.next != NULL) {
+        IFQueueDequeueHead(SOEpollItem*, &queue, item);
+        SOFree(8, item, sizeof(SOEpollItem));
+    }
+
+    return 0;
+}
+
+int SOEpollCtl(int ep, int op, int s, s16 events) {
+    BOOL enabled;
+    SOEpoll* set;
+    SOEpollItem* item;
+    SOEpollItem* alloc;
+    SONode* node;
+    IPInfo* info;
+    int rc;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    node = GetNode(s, &info);
+    if (node == NULL || info == NULL) {
+        return -8;
+    }
+
+    alloc = NULL;
+    if (op == SO_EPOLL_CTL_ADD) {
+        alloc = (SOEpollItem*)SOAlloc(8, sizeof(SOEpollItem));
+        if (alloc == NULL) {
+            PutNode(node);
+            return -49;
+        }
+    }
+
+    rc = 0;
+    enabled = OSDisableInterrupts();
+    set = GetEpoll(ep);
+    item = set != NULL ? LookupEpollItem(set, info) : NULL;
+    if (set == NULL) {
+        rc = -8;
+    } else {
+        switch (op) {
+            case SO_EPOLL_CTL_ADD:
+                if (item != NULL) {
+                    rc = -20;
+                    break;
+                }
+
+                item = alloc;
+                alloc = NULL;
+                memset(item, 0, sizeof(SOEpollItem));
+                item->set = set;
+                item->info = info;
+                item->fd = s;
+                item->events = events;
+                IFQueueEnqueueTailLINK(SOEpollItem*, &EpollHash[SO_EPOLL_HASH(info)], linkHash, item);
+                set->count++;
+                break;
+            case SO_EPOLL_CTL_MOD:
+                if (item == NULL) {
+                    rc = -45;
+                    break;
+                }
+
+                item->events = events;
+                break;
+            case SO_EPOLL_CTL_DEL:
+                if (item == NULL) {
+                    rc = -45;
+                    break;
+                }
+
+                UnlinkEpollItem(item);
+                alloc = item;
+                item = NULL;
+                break;
+            default:
+                rc = -28;
+                break;
+        }
+    }
+    OSRestoreInterrupts(enabled);
+
+    if (alloc != NULL) {
+        SOFree(8, alloc, sizeof(SOEpollItem));
+    }
+
+    if (rc == 0 && item != NULL) {
+        /* Pick up a state that was already ready before registration */
+        __SONotify(info);
+    }
+
+    PutNode(node);
+    return rc;
+}
+
+static void EpollWakeup(OSAlarm* alarm, OSContext* context) {
+    SOEpollWaiter* waiter;
+
+    waiter = (SOEpollWaiter*)((u8*)alarm - offsetof(SOEpollWaiter, alarm));
+    OSWakeupThread(&waiter->set->queueThread);
+}
+
+/* __SONotify is only called from this file; TCPIn, UDPIn and the close
+ * paths in the TCP core never call it. So the set's items are also checked
+ * here, each time SOEpollWait looks for events and at least every
+ * SO_EPOLL_POLL while it sleeps. Must be called with interrupts disabled. */
+static void PollEpollItems(SOEpoll* set) {
+    SOEpollItem* item;
+    int i;
+
+    for (i = 0; i < SO_EPOLL_HASH_NUM; i++) {
+        for (item = (SOEpollItem*)EpollHash[i].next; item != NULL; item = (SOEpollItem*)item->linkHash.next) {
+            if (item->set == set && !item->ready && (GetEvents(item->info) & (item->events | SO_POLLERR | SO_POLLHUP)) != 0) {
+                item->ready = TRUE;
+                IFQueueEnqueueTail(SOEpollItem*, &set->queueReady, item);
+            }
+        }
+    }
+}
+
+int SOEpollWait(int ep, SOPollFD* fds, int nfds, OSTime timeout) {
+    BOOL enabled;
+    SOEpoll* set;
+    SOEpollItem* item;
+    SOEpollWaiter waiter;
+    IFQueue ready;
+    IFQueue done;
+    OSTime deadline;
+    OSTime delay;
+    s16 revents;
+    int n;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    if (fds == NULL || nfds <= 0) {
+        return -28;
+    }
+
+    enabled = OSDisableInterrupts();
+    set = GetEpoll(ep);
+    if (set == NULL) {
+        OSRestoreInterrupts(enabled);
+        return -8;
+    }
+
+    waiter.set = set;
+    OSCreateAlarm(&waiter.alarm);
+    deadline = OSGetTime() + timeout;
+
+    while (TRUE) {
+        PollEpollItems(set);
+        n = 0;
+        ready = set->queueReady;
+        IFQueueInit(&set->queueReady);
+        done.next = done.prev = NULL;
+        while (ready.next != NULL) {
+            IFQueueDequeueHead(SOEpollItem*, &ready, item);
+            if (nfds <= n) {
+                IFQueueEnqueueTail(SOEpollItem*, &set->queueReady, item);
+                continue;
+            }
+
+            revents = GetEvents(item->info) & (item->events | SO_POLLERR | SO_POLLHUP);
+            if (revents == 0) {
+                item->ready = FALSE;
+                continue;
+            }
+
+            fds[n].fd = item->fd;
+            fds[n].events = item->events;
+            fds[n].revents = revents;
+            n++;
+            IFQueueEnqueueTail(SOEpollItem*, &done, item);
+        }
+
+        /* Level triggered: reported entries stay on the ready list behind the
+         * ones not yet returned, so they are rechecked by the next wait. */
+        while (done.next != NULL) {
+            IFQueueDequeueHead(SOEpollItem*, &done, item);
+            IFQueueEnqueueTail(SOEpollItem*, &set->queueReady, item);
+        }
+
+        if (n > 0 || timeout == 0 || State != 1 || !set->used) {
+            break;
+        }
+
+        delay = SO_EPOLL_POLL;
+        if (0 < timeout) {
+            delay = deadline - OSGetTime();
+            if (delay <= 0) {
+                break;
+            }
+            if (SO_EPOLL_POLL < delay) {
+                delay = SO_EPOLL_POLL;
+            }
+        }
+
+        OSSetAlarm(&waiter.alarm, delay, EpollWakeup);
+        OSSleepThread(&set->queueThread);
+        OSCancelAlarm(&waiter.alarm);
+    }
+    OSRestoreInterrupts(enabled);
+
+    if (State != 1) {
+        return -39;
+    }
+
+    return n;
+}
+
+static void CompleteAsync(SOAsync* op, int result) {
+    SOCompletionQueue* queue;
+
+    op->result = result;
+    if (op->callback != NULL) {
+        op->callback(op, result);
+    } else if (op->queue != NULL) {
+        queue = op->queue;
+        IFQueueEnqueueTail(SOAsync*, &queue->queue, op);
+        OSWakeupThread(&queue->queueThread);
+    }
+}
+
+static SOAsyncSlot* GetAsyncSlot(TCPInfo* tcp) {
+    SONode* node;
+
+    node = (SONode*)tcp->node;
+    if (node == NULL) {
+        return NULL;
+    }
+
+    return &AsyncTable[node - SocketTable];
+}
+
+/* Empties the slot of descriptor s and fails the operations still posted on
+ * it with -15, so that none of them completes on a later socket that reuses
+ * the descriptor. */
+static void CancelAsync(int s) {
+    SOAsyncSlot* slot;
+    SOAsync* op;
+    IFQueue queue;
+    BOOL enabled;
+
+    slot = &AsyncTable[s];
+    queue.next = queue.prev = NULL;
+    enabled = OSDisableInterrupts();
+    if (slot->open != NULL) {
+        IFQueueEnqueueTail(SOAsync*, &queue, slot->open);
+        slot->open = NULL;
+    }
+
+    if (slot->send != NULL) {
+        IFQueueEnqueueTail(SOAsync*, &queue, slot->send);
+        slot->send = NULL;
+    }
+
+    if (slot->recv != NULL) {
+        IFQueueEnqueueTail(SOAsync*, &queue, slot->recv);
+        slot->recv = NULL;
+    }
+
+    while (slot->queueAccept.next != NULL) {
+        IFQueueDequeueHead(SOAsync*, &slot->queueAccept, op);
+        IFQueueEnqueueTail(SOAsync*, &queue, op);
+    }
+
+    slot->close = NULL;
+    slot->refill = 0;
+    OSRestoreInterrupts(enabled);
+
+    while (queue.next != NULL) {
+        IFQueueDequeueHead(SOAsync*, &queue, op);
+        CompleteAsync(op, -15);
+    }
+}
+
+void SOInitAsync(SOAsync* op, SOAsyncCallback callback, SOCompletionQueue* queue, void* param) {
+    memset(op, 0, sizeof(SOAsync));
+    op->callback = callback;
+    op->queue = queue;
+    op->param = param;
+}
+
+void SOInitCompletionQueue(SOCompletionQueue* queue) {
+    IFQueueInit(&queue->queue);
+    OSInitThreadQueue(&queue->queueThread);
+}
+
+SOAsync* SOGetCompletion(SOCompletionQueue* queue, BOOL block) {
+    BOOL enabled;
+    SOAsync* op;
+
+    op = NULL;
+    enabled = OSDisableInterrupts();
+    while (queue->queue.next == NULL && block && State == 1) {
+        OSSleepThread(&queue->queueThread);
+    }
+
+    if (queue->queue.next != NULL) {
+        IFQueueDequeueHead(SOAsync*, &queue->queue, op);
+    }
+    OSRestoreInterrupts(enabled);
+    return op;
+}
+
+static void ConnectAsyncCallback(TCPInfo* tcp, s32 result) {
+    SOAsyncSlot* slot;
+    SOAsync* op;
+
+    slot = GetAsyncSlot(tcp);
+    if (slot != NULL && slot->open != NULL) {
+        op = slot->open;
+        slot->open = NULL;
+        CompleteAsync(op, GetConnectError(result));
+    }
+    __SONotify(&tcp->pair);
+}
+
+int SOConnectAsync(int s, void* sockAddr, SOAsync* op) {
+    BOOL enabled;
+    SONode* node;
+    IPInfo* info;
+    TCPInfo* tcp;
+    SOAsyncSlot* slot;
+    s32 rc;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    if (sockAddr == NULL || ((SOSockAddr*)sockAddr)->len < sizeof(SOSockAddrIn)) {
+        return -28;
+    }
+
+    node = GetNode(s, &info);
+    if (node == NULL || info == NULL) {
+        return -8;
+    }
+
+    if (info->proto != IP_PROTO_TCP) {
+        PutNode(node);
+        return -63;
+    }
+
+    tcp = (TCPInfo*)info;
+    slot = &AsyncTable[s];
+    enabled = OSDisableInterrupts();
+    if (slot->open != NULL) {
+        OSRestoreInterrupts(enabled);
+        PutNode(node);
+        return -7;
+    }
+
+    op->s = s;
+    slot->open = op;
+    rc = TCPConnectAsync(tcp, (IPSocket*)sockAddr, &ConnectAsyncCallback, 0);
+    if (rc < 0 || tcp->openCallback == NULL) {
+        /* Failed or connected without waiting; complete right away */
+        slot->open = NULL;
+        OSRestoreInterrupts(enabled);
+        CompleteAsync(op, GetConnectError(rc));
+    } else {
+        OSRestoreInterrupts(enabled);
+    }
+
+    PutNode(node);
+    return 0;
+}
+
+static void CompleteAcceptAsync(SONode* node, TCPInfo* listening) {
+    SOAsyncSlot* slot;
+    SOAsync* op;
+    int rc;
+
+    slot = &AsyncTable[node - SocketTable];
+    while (slot->queueAccept.next != NULL && listening->queueCompleted.next != NULL) {
+        op = (SOAsync*)slot->queueAccept.next;
+        rc = TakeCompleted(node, listening, op->addr.len != 0 ? &op->addr : NULL, op->shard);
+        if (rc == -6) {
+            continue;
+        }
+
+        IFQueueDequeueHead(SOAsync*, &slot->queueAccept, op);
+        if (rc >= 0) {
+            /* Refilled from thread context by the next SO call on the socket */
+            slot->refill++;
+        }
+
+        CompleteAsync(op, rc);
+    }
+}
+
+static void RefillBackLog(int s, TCPInfo* listening) {
+    BOOL enabled;
+    SOAsyncSlot* slot;
+    s32 refill;
+
+    slot = &AsyncTable[s];
+    enabled = OSDisableInterrupts();
+    refill = slot->refill;
+    slot->refill = 0;
+    OSRestoreInterrupts(enabled);
+
+    while (refill-- > 0) {
+        AddBackLog(listening);
+    }
+}
+
+int SOAcceptAsync(int s, SOAsync* op) {
+    BOOL enabled;
+    SONode* node;
+    IPInfo* info;
+    TCPInfo* listening;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    node = GetNode(s, &info);
+    if (node == NULL || info == NULL) {
+        return -8;
+    }
+
+    if (info->proto != IP_PROTO_TCP) {
+        PutNode(node);
+        return -63;
+    }
+
+    listening = (TCPInfo*)info;
+    RefillBackLog(s, listening);
+
+    enabled = OSDisableInterrupts();
+    if (TCPGetStatus(listening) != TCP_STATE_LISTEN) {
+        OSRestoreInterrupts(enabled);
+        PutNode(node);
+        return -28;
+    }
+
+    op->s = s;
+    op->shard = GetThreadShard();
+    IFQueueEnqueueTail(SOAsync*, &AsyncTable[s].queueAccept, op);
+    CompleteAcceptAsync(node, listening);
+    OSRestoreInterrupts(enabled);
+
+    RefillBackLog(s, listening);
+    PutNode(node);
+    return 0;
+}
+
+static void SendAsyncCallback(TCPInfo* tcp, s32 result) {
+    SOAsyncSlot* slot;
+    SOAsync* op;
+
+    slot = GetAsyncSlot(tcp);
+    if (slot != NULL && slot->send != NULL) {
+        op = slot->send;
+        slot->send = NULL;
+        CompleteAsync(op, result < 0 ? -15 : op->len);
+    }
+    __SONotify(&tcp->pair);
+}
+
+static void RecvAsyncCallback(TCPInfo* tcp, s32 result) {
+    SOAsyncSlot* slot;
+    SOAsync* op;
+
+    slot = GetAsyncSlot(tcp);
+    if (slot != NULL && slot->recv != NULL) {
+        op = slot->recv;
+        slot->recv = NULL;
+        CompleteAsync(op, result < 0 ? -15 : result);
+    }
+    __SONotify(&tcp->pair);
+}
+
+static int PostAsync(int s, SOAsync* op, int kind, void* buf, int len) {
+    BOOL enabled;
+    SONode* node;
+    IPInfo* info;
+    TCPInfo* tcp;
+    SOAsync** pending;
+    s32 rc;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    node = GetNode(s, &info);
+    if (node == NULL || info == NULL) {
+        return -8;
+    }
+
+    if (info->proto != IP_PROTO_TCP) {
+        PutNode(node);
+        return -63;
+    }
+
+    tcp = (TCPInfo*)info;
+    if (kind != 0) {
+        __SOTuneRecvBuffer(tcp);
+    }
+
+    pending = kind == 0 ? &AsyncTable[s].send : &AsyncTable[s].recv;
+    enabled = OSDisableInterrupts();
+    if (*pending != NULL) {
+        OSRestoreInterrupts(enabled);
+        PutNode(node);
+        return -7;
+    }
+
+    op->s = s;
+    op->buf = buf;
+    op->len = len;
+    *pending = op;
+    if (kind == 0) {
+        if (!__SOAttachSendBuffer(tcp)) {
+            *pending = NULL;
+            OSRestoreInterrupts(enabled);
+            PutNode(node);
+            return -42;
+        }
+        rc = TCPSendAsync(tcp, buf, len, &SendAsyncCallback, 0);
+    } else {
+        rc = TCPReceiveAsync(tcp, buf, len, &RecvAsyncCallback, 0);
+    }
+
+    if (rc < 0 && *pending == op) {
+        *pending = NULL;
+        OSRestoreInterrupts(enabled);
+        PutNode(node);
+        return rc == -3 ? -15 : -56;
+    }
+    OSRestoreInterrupts(enabled);
+
+    PutNode(node);
+    return 0;
+}
+
+int SOSendAsync(int s, const void* buf, int len, SOAsync* op) {
+    return PostAsync(s, op, 0, (void*)buf, len);
+}
+
+int SORecvAsync(int s, void* buf, int len, SOAsync* op) {
+    return PostAsync(s, op, 1, buf, len);
+}
+
+static void CloseAsyncCallback(TCPInfo* tcp, s32 result) {
+    SONode* node;
+    SOAsyncSlot* slot;
+    SOAsync* op;
+
+    IPTimerCancel(&tcp->lingerAlarm);
+    node = (SONode*)tcp->node;
+    if (node == NULL) {
+        return;
+    }
+
+    slot = &AsyncTable[node - SocketTable];
+    op = slot->close;
+    slot->close = NULL;
+    CancelAsync(node - SocketTable);
+
+    /* Give the descriptor back now; GetNode reclaims the memory later from
+     * thread context like any other lingering connection. */
+    ASSERTLINE(__LINE__, 2 <= node->ref);
+    node->info = NULL;
+    node->proto = 0;
+    node->ref -= 2;
+    tcp->node = NULL;
+    IFQueueEnqueueTail(IPInfo*, &LingerQueue, &tcp->pair);
+
+    if (op != NULL) {
+        CompleteAsync(op, result < 0 ? -15 : 0);
+    }
+}
+
+int SOCloseAsync(int s, SOAsync* op) {
+    BOOL enabled;
+    SONode* node;
+    IPInfo* info;
+    TCPInfo* tcp;
+    s32 state;
+    s32 rc;
+
+    if (State != 1) {
+        return -39;
+    }
+
+    node = GetNode(s, &info);
+    if (node == NULL || info == NULL) {
+        return -8;
+    }
+
+    op->s = s;
+    if (info->proto == IP_PROTO_TCP) {
+        tcp = (TCPInfo*)info;
+        state = TCPGetStatus(tcp);
+        if (state != 0 && state != TCP_STATE_LISTEN && AsyncTable[s].close == NULL) {
+            RemoveEpollItems(info);
+            enabled = OSDisableInterrupts();
+            AsyncTable[s].close = op;
+            IPTimerSet(&tcp->lingerAlarm, OSSecondsToTicks(15), LingerTimeout);
+            rc = TCPCloseAsync(tcp, &CloseAsyncCallback, 0);
+            if (rc < 0) {
+                IPTimerCancel(&tcp->lingerAlarm);
+                AsyncTable[s].close = NULL;
+                OSRestoreInterrupts(enabled);
+                PutNode(node);
+                return -8;
+            }
+            OSRestoreInterrupts(enabled);
+
+            /* The reference taken by GetNode is dropped by the callback */
+            return 0;
+        }
+    }
+
+    /* Nothing to wait for: listening, unconnected and UDP sockets */
+    PutNode(node);
+    rc = __SOClose(s);
+    CompleteAsync(op, rc);
+    return 0;
+}
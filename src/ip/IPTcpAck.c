@@ -0,0 +1,83 @@
+#include <dolphin/ip/IPTcpAck.h>
+#include <dolphin/private/ip.h>
+
+#ifdef NULL
+#undef NULL
+#endif
+
+#define NULL 0
+
+/*
+ * Adaptive delayed-ACK policy. A connection starts in quick-ack mode and
+ * returns to it after an idle period. In this mode each data segment is
+ * ACKed at once, so the peer's slow start and small request/response
+ * exchanges do not wait for dackAlarm. The mode lasts for a number of
+ * segments based on the receive window. After that, full-sized segments are
+ * ACKed once every ackEvery of them and the rest are left to dackAlarm.
+ * Segments that leave a hole, and data that leaves the peer short of
+ * window, are always ACKed immediately. An ackEvery of 0, set through
+ * SOSetAckPolicy, turns delayed ACKs off altogether.
+ */
+
+static s32 GetQuickCount(TCPInfo* tcp) {
+    s32 n;
+
+    n = (0 < tcp->mss) ? tcp->recvBuff / (2 * tcp->mss) : TCP_ACK_QUICK_MAX;
+    if (TCP_ACK_QUICK_MAX < n) {
+        n = TCP_ACK_QUICK_MAX;
+    }
+    return (n < 2) ? 2 : n;
+}
+
+void TCPAckInit(TCPInfo* tcp) {
+    tcp->ackSegs = 0;
+    tcp->ackQuick = GetQuickCount(tcp);
+    tcp->ackEvery = TCP_ACK_EVERY;
+    tcp->ackLastRecv = 0;
+}
+
+/* Called by TCPIn with interrupts disabled for each segment carrying len
+ * bytes of data once it has been queued. Returns TRUE if the segment should
+ * be ACKed now; otherwise the caller arms dackAlarm as before. */
+BOOL TCPAckNow(TCPInfo* tcp, s32 len) {
+    OSTime now;
+    OSTime idle;
+
+    now = OSGetTime();
+    idle = (0 < tcp->rto) ? tcp->rto : TCP_ACK_IDLE;
+    if (tcp->ackLastRecv != 0 && idle < now - tcp->ackLastRecv) {
+        tcp->ackQuick = GetQuickCount(tcp);
+    }
+    tcp->ackLastRecv = now;
+
+    if (tcp->ackEvery <= 0) {
+        return TRUE;
+    }
+
+    if (0 < tcp->ackQuick) {
+        tcp->ackQuick--;
+        return TRUE;
+    }
+
+    /* Out-of-order data: duplicate ACKs drive the peer's recovery */
+    if (TCPSackHasHoles(tcp)) {
+        return TRUE;
+    }
+
+    /* The peer is held back by the window: ACK so it can move on as soon
+     * as possible */
+    if (tcp->recvBuff - tcp->recvUser < 2 * tcp->mss) {
+        return TRUE;
+    }
+
+    if (tcp->mss <= len && tcp->ackEvery <= ++tcp->ackSegs) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Called whenever a segment carrying an ACK goes out, piggybacked or not */
+void TCPAckSent(TCPInfo* tcp) {
+    tcp->ackSegs = 0;
+}
@@ -0,0 +1,398 @@
+#include <dolphin/ip/IPTcpCC.h>
+#include <dolphin/private/ip.h>
+
+#ifdef NULL
+#undef NULL
+#endif
+
+#define NULL 0
+
+/* CUBIC constants (RFC 8312): C = 0.4, beta = 0.7 */
+#define CUBIC_BETA 7 // tenths
+
+/* BBR modes and gains, scaled by 256 */
+#define BBR_STARTUP 0
+#define BBR_DRAIN 1
+#define BBR_PROBE_BW 2
+#define BBR_HIGH_GAIN 739 // 2.89
+#define BBR_DRAIN_GAIN 89 // 1 / 2.89
+#define BBR_UNIT 256
+#define BBR_CYCLE_NUM 8
+#define BBR_BW_ROUNDS 10
+#define BBR_FULL_BW_ROUNDS 3
+
+typedef struct TCPCubicState {
+    // total size: 0x20
+    OSTime epoch; // offset 0x0, size 0x8
+    s32 wMax; // offset 0x8, size 0x4
+    s32 wLastMax; // offset 0xC, size 0x4
+    s32 origin; // offset 0x10, size 0x4
+    s32 k; // offset 0x14, size 0x4
+    s32 wEst; // offset 0x18, size 0x4
+    s32 acked; // offset 0x1C, size 0x4
+} TCPCubicState;
+
+typedef struct TCPBbrState {
+    // total size: 0x28
+    OSTime sampleStart; // offset 0x0, size 0x8
+    s32 sampleDelivered; // offset 0x8, size 0x4
+    s32 btlBw; // offset 0xC, size 0x4
+    s32 fullBw; // offset 0x10, size 0x4
+    s32 bwAge; // offset 0x14, size 0x4
+    s32 mode; // offset 0x18, size 0x4
+    s32 fullBwCount; // offset 0x1C, size 0x4
+    s32 cycle; // offset 0x20, size 0x4
+} TCPBbrState;
+
+static const s32 BbrCycleGain[BBR_CYCLE_NUM] = { 320, 192, 256, 256, 256, 256, 256, 256 };
+
+static s32 GetFlight(TCPInfo* tcp) {
+    return tcp->sendMax - tcp->sendUna;
+}
+
+/* RFC 5681 initial window */
+static s32 GetInitialWindow(TCPInfo* tcp) {
+    s32 win;
+
+    win = (4380 < 2 * tcp->mss) ? 2 * tcp->mss : 4380;
+    return (4 * tcp->mss < win) ? 4 * tcp->mss : win;
+}
+
+static s32 GetLossThresh(TCPInfo* tcp, s32 win) {
+    return (win < 2 * tcp->mss) ? 2 * tcp->mss : win;
+}
+
+static OSTime GetMinRtt(TCPInfo* tcp) {
+    if (0 < tcp->rttMin) {
+        return tcp->rttMin;
+    }
+
+    if (0 < tcp->srtt) {
+        return tcp->srtt;
+    }
+
+    return OSMillisecondsToTicks(100);
+}
+
+/*
+ * Reno (RFC 5681)
+ */
+
+static void RenoInit(TCPInfo* tcp) {
+    tcp->cWin = GetInitialWindow(tcp);
+    tcp->ssThresh = 0x7FFFFFFF;
+}
+
+static void RenoAck(TCPInfo* tcp, s32 acked) {
+    if (tcp->cWin < tcp->ssThresh) {
+        tcp->cWin += (acked < tcp->mss) ? acked : tcp->mss;
+    } else {
+        tcp->cWin += (tcp->mss * tcp->mss) / tcp->cWin + 1;
+    }
+}
+
+static void RenoLoss(TCPInfo* tcp) {
+    tcp->ssThresh = GetLossThresh(tcp, GetFlight(tcp) / 2);
+    tcp->cWin = tcp->ssThresh;
+}
+
+static void RenoRto(TCPInfo* tcp) {
+    tcp->ssThresh = GetLossThresh(tcp, GetFlight(tcp) / 2);
+    tcp->cWin = tcp->mss;
+}
+
+static s32 NoPacing(TCPInfo* tcp) {
+    return 0;
+}
+
+const TCPCongestionOps TCPReno = { "reno", RenoInit, RenoAck, RenoLoss, RenoRto, NoPacing };
+
+/*
+ * CUBIC (RFC 8312). Windows are kept in bytes, time in milliseconds.
+ */
+
+static u32 CubeRoot(u64 x) {
+    u32 lo;
+    u32 hi;
+    u32 mid;
+
+    lo = 0;
+    hi = 2097152; // 2^21, cube exceeds any window we track
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if ((u64)mid * mid * mid <= x) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+static void CubicInit(TCPInfo* tcp) {
+    TCPCubicState* cubic;
+
+    cubic = (TCPCubicState*)tcp->ccState;
+    memset(cubic, 0, sizeof(TCPCubicState));
+    RenoInit(tcp);
+}
+
+static void CubicAck(TCPInfo* tcp, s32 acked) {
+    TCPCubicState* cubic;
+    OSTime now;
+    s64 t;
+    s64 target;
+    s32 segs;
+
+    if (tcp->cWin < tcp->ssThresh) {
+        RenoAck(tcp, acked);
+        return;
+    }
+
+    cubic = (TCPCubicState*)tcp->ccState;
+    now = OSGetTime();
+    if (cubic->epoch == 0) {
+        cubic->epoch = now;
+        cubic->acked = 0;
+        cubic->wEst = tcp->cWin;
+        if (tcp->cWin < cubic->wMax) {
+            /* K = cbrt(wMax * (1 - beta) / C) seconds, in milliseconds */
+            segs = (cubic->wMax - tcp->cWin) / tcp->mss;
+            cubic->k = (s32)CubeRoot((u64)segs * 2500000000LL);
+            cubic->origin = cubic->wMax;
+        } else {
+            cubic->k = 0;
+            cubic->origin = tcp->cWin;
+        }
+    }
+
+    /* W(t) = C * (t - K)^3 + origin, looking one minimum RTT ahead */
+    t = OSTicksToMilliseconds(now - cubic->epoch + GetMinRtt(tcp)) - cubic->k;
+    if (60000 < t) {
+        t = 60000;
+    }
+    target = cubic->origin + (s64)tcp->mss * 4 * t * t * t / 10000000000LL;
+
+    /* TCP-friendly region: Reno with the same average window */
+    cubic->acked += acked;
+    while (tcp->cWin <= cubic->acked) {
+        cubic->acked -= tcp->cWin;
+        cubic->wEst += (tcp->mss * 3 * (10 - CUBIC_BETA)) / (10 + CUBIC_BETA);
+    }
+
+    if (target < cubic->wEst) {
+        target = cubic->wEst;
+    }
+
+    if (tcp->cWin < target) {
+        tcp->cWin += (s32)((target - tcp->cWin) * tcp->mss / tcp->cWin) + 1;
+    } else {
+        tcp->cWin += tcp->mss / 100 + 1;
+    }
+}
+
+static void CubicLoss(TCPInfo* tcp) {
+    TCPCubicState* cubic;
+
+    cubic = (TCPCubicState*)tcp->ccState;
+    cubic->epoch = 0;
+    if (tcp->cWin < cubic->wLastMax) {
+        /* Fast convergence: release bandwidth to newer flows */
+        cubic->wLastMax = tcp->cWin;
+        cubic->wMax = tcp->cWin * (10 + CUBIC_BETA) / 20;
+    } else {
+        cubic->wLastMax = cubic->wMax = tcp->cWin;
+    }
+
+    tcp->ssThresh = GetLossThresh(tcp, tcp->cWin * CUBIC_BETA / 10);
+    tcp->cWin = tcp->ssThresh;
+}
+
+static void CubicRto(TCPInfo* tcp) {
+    TCPCubicState* cubic;
+
+    cubic = (TCPCubicState*)tcp->ccState;
+    cubic->epoch = 0;
+    cubic->wLastMax = cubic->wMax = tcp->cWin;
+    tcp->ssThresh = GetLossThresh(tcp, tcp->cWin * CUBIC_BETA / 10);
+    tcp->cWin = tcp->mss;
+}
+
+const TCPCongestionOps TCPCubic = { "cubic", CubicInit, CubicAck, CubicLoss, CubicRto, NoPacing };
+
+/*
+ * BBR-style model-based control. The bottleneck bandwidth is the windowed
+ * maximum of per-round delivery rate samples, the propagation delay is
+ * rttMin, and the window is twice their product.
+ */
+
+static s32 GetBbrGain(TCPBbrState* bbr) {
+    switch (bbr->mode) {
+        case BBR_STARTUP:
+            return BBR_HIGH_GAIN;
+        case BBR_DRAIN:
+            return BBR_DRAIN_GAIN;
+        default:
+            return BbrCycleGain[bbr->cycle];
+    }
+}
+
+static s32 GetBdp(TCPInfo* tcp, TCPBbrState* bbr) {
+    return (s32)((s64)bbr->btlBw * GetMinRtt(tcp) / OSSecondsToTicks(1));
+}
+
+static void BbrInit(TCPInfo* tcp) {
+    TCPBbrState* bbr;
+
+    bbr = (TCPBbrState*)tcp->ccState;
+    memset(bbr, 0, sizeof(TCPBbrState));
+    bbr->mode = BBR_STARTUP;
+    RenoInit(tcp);
+}
+
+static void BbrRound(TCPInfo* tcp, TCPBbrState* bbr) {
+    switch (bbr->mode) {
+        case BBR_STARTUP:
+            if (bbr->fullBw * 5 / 4 <= bbr->btlBw) {
+                bbr->fullBw = bbr->btlBw;
+                bbr->fullBwCount = 0;
+            } else if (BBR_FULL_BW_ROUNDS <= ++bbr->fullBwCount) {
+                bbr->mode = BBR_DRAIN;
+            }
+            break;
+        case BBR_DRAIN:
+            if (GetFlight(tcp) <= GetBdp(tcp, bbr)) {
+                bbr->mode = BBR_PROBE_BW;
+                bbr->cycle = 0;
+            }
+            break;
+        case BBR_PROBE_BW:
+            bbr->cycle = (bbr->cycle + 1) % BBR_CYCLE_NUM;
+            break;
+    }
+}
+
+static void BbrAck(TCPInfo* tcp, s32 acked) {
+    TCPBbrState* bbr;
+    OSTime now;
+    OSTime elapsed;
+    s32 rate;
+    s32 target;
+
+    bbr = (TCPBbrState*)tcp->ccState;
+    now = OSGetTime();
+    if (bbr->sampleStart == 0) {
+        bbr->sampleStart = now;
+    }
+
+    bbr->sampleDelivered += acked;
+    elapsed = now - bbr->sampleStart;
+    if (((0 < tcp->srtt) ? tcp->srtt : GetMinRtt(tcp)) <= elapsed) {
+        rate = (s32)((s64)bbr->sampleDelivered * OSSecondsToTicks(1) / elapsed);
+        bbr->sampleStart = now;
+        bbr->sampleDelivered = 0;
+        if (bbr->btlBw <= rate || BBR_BW_ROUNDS < ++bbr->bwAge) {
+            bbr->btlBw = rate;
+            bbr->bwAge = 0;
+        }
+        BbrRound(tcp, bbr);
+    }
+
+    if (bbr->mode == BBR_STARTUP || bbr->btlBw == 0) {
+        tcp->cWin += acked;
+        return;
+    }
+
+    target = 2 * GetBdp(tcp, bbr);
+    if (target < 4 * tcp->mss) {
+        target = 4 * tcp->mss;
+    }
+
+    /* Grow back towards the model after a loss or timeout */
+    tcp->cWin = (tcp->cWin + acked < target) ? tcp->cWin + acked : target;
+}
+
+static void BbrLoss(TCPInfo* tcp) {
+    s32 flight;
+
+    /* Packet conservation: keep what is in flight, do not back off */
+    flight = GetFlight(tcp);
+    tcp->cWin = (flight < 4 * tcp->mss) ? 4 * tcp->mss : flight;
+}
+
+static void BbrRto(TCPInfo* tcp) {
+    TCPBbrState* bbr;
+
+    bbr = (TCPBbrState*)tcp->ccState;
+    bbr->sampleStart = 0;
+    bbr->sampleDelivered = 0;
+    tcp->cWin = tcp->mss;
+}
+
+static s32 BbrPacingRate(TCPInfo* tcp) {
+    TCPBbrState* bbr;
+
+    bbr = (TCPBbrState*)tcp->ccState;
+    return (s32)((s64)bbr->btlBw * GetBbrGain(bbr) / BBR_UNIT);
+}
+
+const TCPCongestionOps TCPBbr = { "bbr", BbrInit, BbrAck, BbrLoss, BbrRto, BbrPacingRate };
+
+const TCPCongestionOps* TCPCongestionTable[TCP_CC_NUM] = { &TCPReno, &TCPCubic, &TCPBbr };
+
+/*
+ * The TCP core calls these in place of its inline window arithmetic:
+ * TCPCongestionInit on entering ESTABLISHED, TCPCongestionAck for each ACK
+ * that advances sendUna, TCPCongestionLoss on entering fast recovery and
+ * TCPCongestionRto on a retransmission timeout.
+ */
+
+/* Selects the algorithm; its state is set up by TCPCongestionInit once the
+ * connection is established and mss is known. The state of one algorithm
+ * means nothing to another, so a live connection keeps the one it has:
+ * returns -7 then, unless ops is already in use. */
+s32 TCPSetCongestion(TCPInfo* tcp, const TCPCongestionOps* ops) {
+    BOOL enabled;
+    s32 rc;
+
+    if (ops == NULL) {
+        ops = &TCPReno;
+    }
+
+    rc = 0;
+    enabled = OSDisableInterrupts();
+    if (tcp->cc != ops) {
+        if (tcp->cc != NULL && TCP_STATE_ESTABLISHED <= tcp->state) {
+            rc = -7;
+        } else {
+            tcp->cc = ops;
+        }
+    }
+    OSRestoreInterrupts(enabled);
+    return rc;
+}
+
+void TCPCongestionInit(TCPInfo* tcp) {
+    if (tcp->cc == NULL) {
+        tcp->cc = &TCPReno;
+    }
+    tcp->cc->init(tcp);
+}
+
+void TCPCongestionAck(TCPInfo* tcp, s32 acked) {
+    if (0 < acked) {
+        tcp->cc->onAck(tcp, acked);
+    }
+}
+
+void TCPCongestionLoss(TCPInfo* tcp) {
+    tcp->cc->onLoss(tcp);
+}
+
+void TCPCongestionRto(TCPInfo* tcp) {
+    tcp->cc->onRto(tcp);
+}
+
+s32 TCPGetPacingRate(TCPInfo* tcp) {
+    return tcp->cc->getPacingRate(tcp);
+}
@@ -0,0 +1,148 @@
+#include <dolphin/ip/IPTcpFastOpen.h>
+#include <dolphin/private/ip.h>
+
+#ifdef NULL
+#undef NULL
+#endif
+
+#define NULL 0
+
+/*
+ * TCP Fast Open (RFC 7413). A client keeps the cookies servers have given it
+ * in a small cache keyed by server address, replacing the least recently
+ * used entry. With a cookie cached, the first queued bytes can go in the
+ * SYN; without one the SYN asks for a cookie. A server issues cookies keyed
+ * to the client's address.
+ *
+ * These are the pieces the TCP core needs: TCPOut would call
+ * TCPFastOpenBuildSyn and TCPIn TCPFastOpenSynAck and
+ * TCPFastOpenCheckCookie. Until it does, nothing here is reached and
+ * SOSetFastOpen refuses to enable Fast Open.
+ */
+
+static TCPFastOpenEntry Cache[TCP_FASTOPEN_CACHE_NUM]; // size: 0x200
+static u32 Secret[2];
+
+static u32 Mix(u32 h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    h ^= h >> 16;
+    return h;
+}
+
+void TCPFastOpenInit(void) {
+    BOOL enabled;
+
+    enabled = OSDisableInterrupts();
+    memset(Cache, 0, sizeof(Cache));
+    Secret[0] = Mix((u32)OSGetTime() ^ OSGetTick());
+    Secret[1] = Mix(Secret[0] ^ (u32)(OSGetTime() >> 32));
+    OSRestoreInterrupts(enabled);
+}
+
+/* Server side: the cookie for a client address, TCP_FASTOPEN_COOKIE_LEN
+ * bytes */
+void TCPFastOpenMakeCookie(const u8* addr, u8* cookie) {
+    u32 h[2];
+
+    h[0] = Mix(IPU32(addr) ^ Secret[0]);
+    h[1] = Mix(h[0] ^ Secret[1]);
+    memmove(cookie, h, TCP_FASTOPEN_COOKIE_LEN);
+}
+
+BOOL TCPFastOpenCheckCookie(const u8* addr, const TCPOptions* opt) {
+    u8 cookie[TCP_FASTOPEN_COOKIE_LEN];
+
+    if (!(opt->flag & TCP_OPT_FLAG_TFO) || opt->cookieLen != TCP_FASTOPEN_COOKIE_LEN) {
+        return FALSE;
+    }
+
+    TCPFastOpenMakeCookie(addr, cookie);
+    return memcmp(cookie, opt->cookie, TCP_FASTOPEN_COOKIE_LEN) == 0;
+}
+
+/* Writes a Fast Open option, a cookie request if len is 0, padded with NOPs
+ * to a multiple of 4. Returns the length written. */
+s32 TCPFastOpenBuildOption(u8* opt, const u8* cookie, int len) {
+    s32 n;
+
+    n = 0;
+    while ((2 + len + n) & 3) {
+        opt[n++] = TCP_OPT_NOP;
+    }
+
+    opt[n] = TCP_OPT_FASTOPEN;
+    opt[n + 1] = (u8)(2 + len);
+    memmove(opt + n + 2, cookie, len);
+    return n + 2 + len;
+}
+
+static TCPFastOpenEntry* Lookup(const u8* addr) {
+    int i;
+
+    for (i = 0; i < TCP_FASTOPEN_CACHE_NUM; i++) {
+        if (Cache[i].len != 0 && IPEQ(Cache[i].addr, addr)) {
+            return &Cache[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Client side, called by TCPOut with interrupts disabled when building the
+ * SYN of a connection with TCP_OPT_FLAG_TFO set. Writes the cached cookie
+ * for the server, or a cookie request, and sets tfoLen to the number of
+ * queued send bytes to carry in the SYN. Returns the option length, at most
+ * TCP_OPT_FASTOPEN_LEN. */
+s32 TCPFastOpenBuildSyn(TCPInfo* tcp, u8* opt) {
+    TCPFastOpenEntry* entry;
+    s32 len;
+
+    entry = Lookup(tcp->pair.remote.addr);
+    if (entry == NULL) {
+        tcp->tfoLen = 0;
+        return TCPFastOpenBuildOption(opt, NULL, 0);
+    }
+
+    entry->used = OSGetTime();
+    len = (entry->mss < tcp->mss) ? entry->mss : tcp->mss;
+    tcp->tfoLen = (tcp->sendLen < len) ? tcp->sendLen : len;
+    return TCPFastOpenBuildOption(opt, entry->cookie, entry->len);
+}
+
+/* Client side, called by TCPIn for the SYN-ACK of a Fast Open connection.
+ * Stores a cookie the server returned. A server that answers a cookie with
+ * no Fast Open option at all has turned it off, so its cookie is dropped.
+ * SYN data the SYN-ACK does not cover stays queued and is sent again
+ * normally. */
+void TCPFastOpenSynAck(TCPInfo* tcp, const TCPHeader* th, const TCPOptions* opt) {
+    TCPFastOpenEntry* entry;
+    int i;
+
+    entry = Lookup(tcp->pair.remote.addr);
+    if (opt->flag & TCP_OPT_FLAG_TFO) {
+        if (opt->cookieLen != 0) {
+            if (entry == NULL) {
+                entry = &Cache[0];
+                for (i = 1; i < TCP_FASTOPEN_CACHE_NUM; i++) {
+                    if (Cache[i].used < entry->used) {
+                        entry = &Cache[i];
+                    }
+                }
+                memmove(entry->addr, tcp->pair.remote.addr, 4);
+            }
+
+            entry->len = opt->cookieLen;
+            memmove(entry->cookie, opt->cookie, opt->cookieLen);
+            entry->mss = opt->mss;
+            entry->used = OSGetTime();
+        }
+    } else if (entry != NULL && 0 < tcp->tfoLen) {
+        entry->len = 0;
+        entry->used = 0;
+    }
+
+    tcp->tfoLen = 0;
+}
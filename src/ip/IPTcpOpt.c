@@ -0,0 +1,267 @@
+#include <dolphin/ip/IPTcpOpt.h>
+#include <dolphin/private/ip.h>
+
+#ifdef NULL
+#undef NULL
+#endif
+
+#define NULL 0
+
+/*
+ * RFC 7323 window scaling and timestamps, plus the SACK-permitted option.
+ * A new PCB offers all three; TCPOptNegotiate keeps whatever the peer's SYN
+ * or SYN-ACK offered too. TCPInfo.optFlag holds the result, and the
+ * scale factors are fixed from then on.
+ *
+ * IPSocket.c calls TCPOptInit for each new PCB and TCPOptGetMaxWindow when
+ * autotuning. The rest (parsing, negotiation, building options, PAWS, RTT
+ * samples and the window field conversions) is for TCPIn and TCPOut in the
+ * TCP core, which is not in this tree and does not call it yet. Until
+ * TCPOptNegotiate runs, TCP_OPT_FLAG_NEGOTIATED stays clear, so a
+ * connection is treated as having no options and its window stays within
+ * 0xFFFF.
+ */
+
+/* Timestamp clock: one millisecond per tick */
+u32 TCPOptGetTsVal(void) {
+    return (u32)OSTicksToMilliseconds(OSGetTime());
+}
+
+/* Smallest shift that lets a window of size bytes be advertised */
+u8 TCPOptGetRecvScale(s32 size) {
+    u8 scale;
+
+    for (scale = 0; scale < TCP_WSCALE_MAX && 0xFFFF < (size >> scale); scale++) {
+        ;
+    }
+    return scale;
+}
+
+/* Prepares a PCB to offer window scaling, timestamps and SACK in its SYN */
+void TCPOptInit(TCPInfo* tcp) {
+    tcp->recvScale = TCPOptGetRecvScale(SO_BUF_MAX);
+    tcp->sendScale = 0;
+    tcp->optFlag = TCP_OPT_FLAG_WSCALE | TCP_OPT_FLAG_TS | TCP_OPT_FLAG_SACK;
+    tcp->tsRecent = 0;
+    tcp->tsRecentAge = 0;
+    tcp->lastAckSent = tcp->recvNext;
+}
+
+void TCPOptParse(const TCPHeader* tcp, TCPOptions* opt) {
+    const u8* ptr;
+    const u8* end;
+
+    opt->mss = 536;
+    opt->wscale = 0;
+    opt->flag = 0;
+    opt->tsVal = opt->tsEcr = 0;
+    opt->cookieLen = 0;
+
+    ptr = (const u8*)tcp + sizeof(TCPHeader);
+    end = (const u8*)tcp + TCP_HLEN(tcp);
+    while (ptr < end) {
+        switch (ptr[0]) {
+            case TCP_OPT_EOL:
+                return;
+            case TCP_OPT_NOP:
+                ptr++;
+                continue;
+        }
+
+        if (ptr + 1 >= end || ptr[1] < 2 || end < ptr + ptr[1]) {
+            return;
+        }
+
+        switch (ptr[0]) {
+            case TCP_OPT_MSS:
+                if (ptr[1] == 4 && (tcp->flag & TCP_FLAG_SYN)) {
+                    opt->mss = (u16)((ptr[2] << 8) | ptr[3]);
+                    opt->flag |= TCP_OPT_FLAG_MSS;
+                }
+                break;
+            case TCP_OPT_WSCALE:
+                if (ptr[1] == 3 && (tcp->flag & TCP_FLAG_SYN)) {
+                    opt->wscale = (u8)((ptr[2] < TCP_WSCALE_MAX) ? ptr[2] : TCP_WSCALE_MAX);
+                    opt->flag |= TCP_OPT_FLAG_WSCALE;
+                }
+                break;
+            case TCP_OPT_SACK_PERMITTED:
+                if (ptr[1] == 2 && (tcp->flag & TCP_FLAG_SYN)) {
+                    opt->flag |= TCP_OPT_FLAG_SACK;
+                }
+                break;
+            case TCP_OPT_TS:
+                if (ptr[1] == 10) {
+                    memmove(&opt->tsVal, ptr + 2, 4);
+                    memmove(&opt->tsEcr, ptr + 6, 4);
+                    opt->flag |= TCP_OPT_FLAG_TS;
+                }
+                break;
+            case TCP_OPT_FASTOPEN:
+                /* An empty option requests a cookie */
+                if ((tcp->flag & TCP_FLAG_SYN) && (ptr[1] == 2 || (6 <= ptr[1] && ptr[1] <= 2 + TCP_OPT_COOKIE_MAX && (ptr[1] & 1) == 0))) {
+                    opt->cookieLen = (u8)(ptr[1] - 2);
+                    memmove(opt->cookie, ptr + 2, opt->cookieLen);
+                    opt->flag |= TCP_OPT_FLAG_TFO;
+                }
+                break;
+        }
+
+        ptr += ptr[1];
+    }
+}
+
+/* Called with the options of the peer's SYN (passive open) or SYN-ACK
+ * (active open). Options either side left out are turned off. */
+void TCPOptNegotiate(TCPInfo* tcp, const TCPOptions* opt) {
+    tcp->optFlag &= opt->flag | TCP_OPT_FLAG_MSS;
+    tcp->optFlag |= TCP_OPT_FLAG_NEGOTIATED;
+
+    if (tcp->optFlag & TCP_OPT_FLAG_WSCALE) {
+        tcp->sendScale = opt->wscale;
+    } else {
+        tcp->sendScale = tcp->recvScale = 0;
+    }
+
+    if (tcp->optFlag & TCP_OPT_FLAG_TS) {
+        tcp->tsRecent = opt->tsVal;
+        tcp->tsRecentAge = OSGetTime();
+    }
+}
+
+/* Builds the options of a SYN or SYN-ACK. flag selects the options beyond
+ * MSS; tsEcr is the peer's timestamp for a SYN-ACK and 0 for a SYN. Returns
+ * the option length, at most TCP_OPT_SYN_LEN. */
+s32 TCPOptBuildSyn(u8* opt, u16 mss, u16 flag, u8 recvScale, u32 tsEcr) {
+    u8* ptr;
+    u32 tsVal;
+
+    ptr = opt;
+    *ptr++ = TCP_OPT_MSS;
+    *ptr++ = 4;
+    *ptr++ = (u8)(mss >> 8);
+    *ptr++ = (u8)mss;
+
+    if (flag & TCP_OPT_FLAG_TS) {
+        if (flag & TCP_OPT_FLAG_SACK) {
+            *ptr++ = TCP_OPT_SACK_PERMITTED;
+            *ptr++ = 2;
+        } else {
+            *ptr++ = TCP_OPT_NOP;
+            *ptr++ = TCP_OPT_NOP;
+        }
+        *ptr++ = TCP_OPT_TS;
+        *ptr++ = 10;
+        tsVal = TCPOptGetTsVal();
+        memmove(ptr, &tsVal, 4);
+        memmove(ptr + 4, &tsEcr, 4);
+        ptr += 8;
+    } else if (flag & TCP_OPT_FLAG_SACK) {
+        *ptr++ = TCP_OPT_NOP;
+        *ptr++ = TCP_OPT_NOP;
+        *ptr++ = TCP_OPT_SACK_PERMITTED;
+        *ptr++ = 2;
+    }
+
+    if (flag & TCP_OPT_FLAG_WSCALE) {
+        *ptr++ = TCP_OPT_NOP;
+        *ptr++ = TCP_OPT_WSCALE;
+        *ptr++ = 3;
+        *ptr++ = recvScale;
+    }
+
+    return ptr - opt;
+}
+
+/* Builds the timestamp option of a non-SYN segment, which is sent with
+ * every segment once negotiated. Returns 0 or TCP_OPT_TS_LEN; the rest of
+ * the option area is left for SACK blocks. */
+s32 TCPOptBuild(TCPInfo* tcp, u8* opt) {
+    u32 tsVal;
+
+    if (!(tcp->optFlag & TCP_OPT_FLAG_TS)) {
+        return 0;
+    }
+
+    opt[0] = TCP_OPT_NOP;
+    opt[1] = TCP_OPT_NOP;
+    opt[2] = TCP_OPT_TS;
+    opt[3] = 10;
+    tsVal = TCPOptGetTsVal();
+    memmove(opt + 4, &tsVal, 4);
+    memmove(opt + 8, &tcp->tsRecent, 4);
+    tcp->lastAckSent = tcp->recvNext;
+    return TCP_OPT_TS_LEN;
+}
+
+/* PAWS (RFC 7323 section 5). Returns FALSE if the segment carries a
+ * timestamp older than TS.Recent; the caller then ACKs and drops it unless
+ * it is a RST. Otherwise records the timestamp for echoing. */
+BOOL TCPOptPaws(TCPInfo* tcp, const TCPHeader* th, const TCPOptions* opt) {
+    OSTime now;
+
+    if (!(tcp->optFlag & TCP_OPT_FLAG_TS) || !(opt->flag & TCP_OPT_FLAG_TS)) {
+        return TRUE;
+    }
+
+    now = OSGetTime();
+    if ((s32)(opt->tsVal - tcp->tsRecent) < 0) {
+        if (th->flag & TCP_FLAG_RST) {
+            return TRUE;
+        }
+
+        if (now - tcp->tsRecentAge <= TCP_PAWS_IDLE) {
+            return FALSE;
+        }
+    }
+
+    if (TCP_SEQ_LEQ(th->seq, tcp->lastAckSent)) {
+        tcp->tsRecent = opt->tsVal;
+        tcp->tsRecentAge = now;
+    }
+
+    return TRUE;
+}
+
+/* Returns an RTT sample from the echoed timestamp of an ACK that advances
+ * sendUna, or 0 if it has none. Unlike rttSeq timing this yields a sample
+ * for every such ACK, retransmissions included. */
+OSTime TCPOptRttSample(TCPInfo* tcp, const TCPOptions* opt) {
+    u32 ms;
+
+    if (!(tcp->optFlag & TCP_OPT_FLAG_TS) || !(opt->flag & TCP_OPT_FLAG_TS) || opt->tsEcr == 0) {
+        return 0;
+    }
+
+    ms = TCPOptGetTsVal() - opt->tsEcr;
+    if ((s32)ms < 0) {
+        return 0;
+    }
+
+    return OSMillisecondsToTicks((OSTime)((ms != 0) ? ms : 1));
+}
+
+/* The window field of a SYN is never scaled */
+s32 TCPOptGetSendWindow(TCPInfo* tcp, const TCPHeader* th) {
+    if (th->flag & TCP_FLAG_SYN) {
+        return th->win;
+    }
+    return (s32)th->win << tcp->sendScale;
+}
+
+/* The window of a SYN or SYN-ACK goes out unscaled and must not be passed
+ * through here. Under memory pressure the window is narrowed first. */
+u16 TCPOptPutRecvWindow(TCPInfo* tcp, s32 win) {
+    win = __SOClampWindow(tcp, win);
+    win >>= tcp->recvScale;
+    return (u16)((win < 0xFFFF) ? win : 0xFFFF);
+}
+
+/* Largest receive window the connection can advertise. Until the SYN
+ * exchange has confirmed window scaling, assume it is off. */
+s32 TCPOptGetMaxWindow(TCPInfo* tcp) {
+    if ((tcp->optFlag & (TCP_OPT_FLAG_WSCALE | TCP_OPT_FLAG_NEGOTIATED)) != (TCP_OPT_FLAG_WSCALE | TCP_OPT_FLAG_NEGOTIATED)) {
+        return 0xFFFF;
+    }
+    return 0xFFFF << tcp->recvScale;
+}
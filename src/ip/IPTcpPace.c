@@ -0,0 +1,172 @@
+#include <dolphin/ip/IPTcpPace.h>
+#include <dolphin/private/ip.h>
+
+#ifdef NULL
+#undef NULL
+#endif
+
+#define NULL 0
+
+/* Segments due within this much of now go out without waiting */
+#define TCP_PACE_SLACK OSMicrosecondsToTicks(250)
+
+/*
+ * Connections waiting for their next segment to become due are kept on
+ * PaceQueue in paceNext order, behind one timer on the IPTimer wheel set
+ * for the head. The wheel fires on IP_TIMER_TICK boundaries, so a paced
+ * connection sends at most one tick's worth of segments in a burst.
+ */
+static IFQueue PaceQueue; // sorted by paceNext
+static IPTimer PaceTimer;
+static OSTime PaceFire;
+static TCPPaceOutput Output;
+
+static void PaceCallback(IPTimer* timer);
+
+static void ArmPaceTimer(void) {
+    TCPInfo* head;
+    OSTime now;
+
+    head = (TCPInfo*)PaceQueue.next;
+    if (head == NULL) {
+        IPTimerCancel(&PaceTimer);
+        PaceFire = 0;
+        return;
+    }
+
+    if (PaceFire == head->paceNext && IPTimerIsArmed(&PaceTimer)) {
+        return;
+    }
+
+    PaceFire = head->paceNext;
+    now = OSGetTime();
+    IPTimerSet(&PaceTimer, (now < PaceFire) ? PaceFire - now : 1, PaceCallback);
+}
+
+static void PaceCallback(IPTimer* timer) {
+    TCPInfo* tcp;
+    OSTime now;
+
+    PaceFire = 0;
+    now = OSGetTime();
+    while (PaceQueue.next != NULL) {
+        tcp = (TCPInfo*)PaceQueue.next;
+        if (now + TCP_PACE_SLACK < tcp->paceNext) {
+            break;
+        }
+
+        IFQueueDequeueHeadLINK(TCPInfo*, &PaceQueue, linkPace, tcp);
+        tcp->paceQueued = FALSE;
+        if (Output != NULL) {
+            Output(tcp);
+        }
+    }
+
+    ArmPaceTimer();
+}
+
+void TCPPaceInit(void) {
+    BOOL enabled;
+
+    enabled = OSDisableInterrupts();
+    IPTimerCancel(&PaceTimer);
+    IPTimerCreate(&PaceTimer);
+    PaceFire = 0;
+    PaceQueue.next = PaceQueue.prev = NULL;
+    OSRestoreInterrupts(enabled);
+}
+
+/* Registers the TCP output routine the pacing timer calls to resume a
+ * connection whose next segment has become due. */
+void TCPPaceSetOutput(TCPPaceOutput output) {
+    Output = output;
+}
+
+/* Returns the pacing rate in bytes per second, or 0 if the connection is
+ * not paced. The rate is the congestion controller's own if it has one,
+ * otherwise cwnd/srtt scaled by a gain, and never above paceMaxRate. */
+s32 TCPGetPaceRate(TCPInfo* tcp) {
+    s32 rate;
+    s32 gain;
+
+    rate = (tcp->cc != NULL) ? TCPGetPacingRate(tcp) : 0;
+    if (rate == 0 && 0 < tcp->srtt) {
+        gain = (tcp->cWin < tcp->ssThresh) ? TCP_PACE_GAIN_SS : TCP_PACE_GAIN_CA;
+        rate = (s32)((s64)tcp->cWin * gain * OSSecondsToTicks(1) / (100 * tcp->srtt));
+    }
+
+    if (0 < tcp->paceMaxRate && (rate == 0 || tcp->paceMaxRate < rate)) {
+        rate = tcp->paceMaxRate;
+    }
+
+    return rate;
+}
+
+/* Called by the TCP output path with interrupts disabled before each
+ * segment. Returns TRUE if the segment may go now; otherwise the connection
+ * is queued on the pacing timer and the output routine is called again once
+ * it is due. */
+BOOL TCPPaceCheck(TCPInfo* tcp) {
+    TCPInfo* next;
+    TCPInfo* prev;
+
+    if (tcp->paceNext <= OSGetTime() + TCP_PACE_SLACK) {
+        return TRUE;
+    }
+
+    if (!tcp->paceQueued) {
+        prev = NULL;
+        for (next = (TCPInfo*)PaceQueue.next; next != NULL; next = (TCPInfo*)next->linkPace.next) {
+            if (tcp->paceNext < next->paceNext) {
+                break;
+            }
+            prev = next;
+        }
+
+        if (prev == NULL) {
+            IFQueueEnqueueHeadLINK(TCPInfo*, &PaceQueue, linkPace, tcp);
+        } else if (next == NULL) {
+            IFQueueEnqueueTailLINK(TCPInfo*, &PaceQueue, linkPace, tcp);
+        } else {
+            tcp->linkPace.prev = (IFQueue*)prev;
+            tcp->linkPace.next = (IFQueue*)next;
+            prev->linkPace.next = (IFQueue*)tcp;
+            next->linkPace.prev = (IFQueue*)tcp;
+        }
+
+        tcp->paceQueued = TRUE;
+        ArmPaceTimer();
+    }
+
+    return FALSE;
+}
+
+/* Called after a segment of len bytes has been handed to IPOut */
+void TCPPaceSent(TCPInfo* tcp, s32 len) {
+    OSTime now;
+    s32 rate;
+
+    rate = TCPGetPaceRate(tcp);
+    if (rate <= 0) {
+        tcp->paceNext = 0;
+        return;
+    }
+
+    now = OSGetTime();
+    if (tcp->paceNext < now) {
+        tcp->paceNext = now;
+    }
+    tcp->paceNext += (s64)len * OSSecondsToTicks(1) / rate;
+}
+
+void TCPPaceCancel(TCPInfo* tcp) {
+    BOOL enabled;
+
+    enabled = OSDisableInterrupts();
+    if (tcp->paceQueued) {
+        IFQueueDequeueEntryLINK(TCPInfo*, &PaceQueue, linkPace, tcp);
+        tcp->paceQueued = FALSE;
+        ArmPaceTimer();
+    }
+    OSRestoreInterrupts(enabled);
+}
@@ -0,0 +1,191 @@
+#include <dolphin/ip/IPTcpPredict.h>
+#include <dolphin/private/ip.h>
+
+#ifdef NULL
+#undef NULL
+#endif
+
+#define NULL 0
+
+/*
+ * Header prediction (Van Jacobson). On an established connection nearly
+ * every segment is either a pure ACK for new data while sending or the next
+ * in-order data segment while receiving. TCPIn offers each segment to
+ * TCPPredictIn first. A handful of compares decide whether it is one of
+ * these cases; if so the send or receive ring is updated here, and the
+ * result tells TCPIn which of its usual follow-ups to run. Anything else,
+ * including every segment during loss recovery, takes the slow path
+ * unchanged.
+ *
+ * Only a bare header or one carrying just the timestamp option in the
+ * RFC 7323 appendix A layout is predicted.
+ *
+ * TCPIn is in the TCP core, outside this tree, and does not call
+ * TCPPredictIn or TCPPredictAccount yet; until it does every segment takes
+ * the slow path and the statistics stay at zero.
+ *
+ * When the user has a receive posted (userData) and the ring holds no data,
+ * in-order payload is copied straight from the frame into the user's buffer
+ * and never enters the ring.
+ */
+
+static TCPPredictStat Stat;
+
+static BOOL GetTimestamp(TCPInfo* tcp, const TCPHeader* th, TCPOptions* opt) {
+    const u8* ptr;
+
+    opt->flag = 0;
+    switch (TCP_HLEN(th)) {
+        case sizeof(TCPHeader):
+            return !(tcp->optFlag & TCP_OPT_FLAG_TS);
+        case sizeof(TCPHeader) + TCP_OPT_TS_LEN:
+            ptr = (const u8*)th + sizeof(TCPHeader);
+            if (ptr[0] != TCP_OPT_NOP || ptr[1] != TCP_OPT_NOP || ptr[2] != TCP_OPT_TS || ptr[3] != 10) {
+                return FALSE;
+            }
+            memmove(&opt->tsVal, ptr + 4, 4);
+            memmove(&opt->tsEcr, ptr + 8, 4);
+            opt->flag = TCP_OPT_FLAG_TS;
+            return (tcp->optFlag & TCP_OPT_FLAG_TS) && 0 <= (s32)(opt->tsVal - tcp->tsRecent);
+    }
+    return FALSE;
+}
+
+/* Called by TCPIn with interrupts disabled once the segment has passed its
+ * checksum and been matched to tcp. data and len are the payload. Returns
+ * TCP_PREDICT_NONE if the segment needs the slow path, having changed
+ * nothing. Otherwise the segment has been consumed and opt holds its
+ * timestamps, and TCPIn still has to:
+ *   TCP_PREDICT_ACKED    take an RTT sample, restart or stop rxmitAlarm,
+ *                        complete the user's send and call TCPOut;
+ *   TCP_PREDICT_DATA     complete the user's pending receive;
+ *   TCP_PREDICT_ACK_NOW  send an ACK now rather than arm dackAlarm;
+ *   TCP_PREDICT_PLACED   as TCPPredictPlace.
+ */
+s32 TCPPredictIn(TCPInfo* tcp, const TCPHeader* th, const u8* data, s32 len, TCPOptions* opt) {
+    s32 acked;
+    s32 room;
+    s32 result;
+
+    if (tcp->state != TCP_STATE_ESTABLISHED ||
+        (th->flag & (TCP_FLAG_FIN | TCP_FLAG_SYN | TCP_FLAG_RST | TCP_FLAG_ACK | TCP_FLAG_URG)) != TCP_FLAG_ACK ||
+        th->seq != tcp->recvNext || tcp->sendNext != tcp->sendMax || TCPOptGetSendWindow(tcp, th) != tcp->sendWin ||
+        !GetTimestamp(tcp, th, opt))
+    {
+        return TCP_PREDICT_NONE;
+    }
+
+    if (len == 0) {
+        /* Pure ACK for new data, outside recovery and not limited by cWin */
+        if (!TCP_SEQ_LT(tcp->sendUna, th->ack) || TCP_SEQ_LT(tcp->sendMax, th->ack) || tcp->cWin < tcp->sendWin ||
+            tcp->dupAcks != 0 || tcp->sackCount != 0 || tcp->rackLost != 0)
+        {
+            return TCP_PREDICT_NONE;
+        }
+
+        if (opt->flag & TCP_OPT_FLAG_TS) {
+            tcp->tsRecent = opt->tsVal;
+            tcp->tsRecentAge = OSGetTime();
+        }
+
+        acked = th->ack - tcp->sendUna;
+        tcp->sendPtr = IFRingPut(tcp->sendData, tcp->sendBuff, tcp->sendPtr, tcp->sendLen, acked);
+        tcp->sendLen -= acked;
+        tcp->sendUna = th->ack;
+        tcp->sendWL2 = th->ack;
+        TCPRackAck(tcp);
+        TCPCongestionAck(tcp, acked);
+        Stat.ackSegs++;
+        return TCP_PREDICT_ACKED;
+    }
+
+    /* In-order data that fits, acknowledging nothing new, with no holes.
+     * The slow path in TCPIn keeps its blocks in TCPInfo.asb. */
+    room = (tcp->userData != NULL && tcp->recvUser == 0) ? tcp->userBuff - tcp->userLen : 0;
+    if (th->ack != tcp->sendUna || tcp->asb[0].ptr != NULL ||
+        (room < len && (tcp->recvData == NULL || tcp->recvBuff - tcp->recvUser < len - room)))
+    {
+        return TCP_PREDICT_NONE;
+    }
+
+    if ((opt->flag & TCP_OPT_FLAG_TS) && th->seq == tcp->lastAckSent) {
+        tcp->tsRecent = opt->tsVal;
+        tcp->tsRecentAge = OSGetTime();
+    }
+
+    result = TCP_PREDICT_DATA;
+    if (0 < room) {
+        room = TCPPredictPlace(tcp, data, len);
+        result |= TCP_PREDICT_PLACED;
+    }
+
+    if (room < len) {
+        IFRingIn(tcp->recvData, tcp->recvBuff, tcp->recvPtr, tcp->recvUser, data + room, len - room);
+        tcp->recvUser += len - room;
+    }
+    tcp->recvNext += len;
+    Stat.dataSegs++;
+    return TCPAckNow(tcp, len) ? (result | TCP_PREDICT_ACK_NOW) : result;
+}
+
+/* Copies in-order payload straight into the posted user receive buffer,
+ * bypassing the ring, and returns the number of bytes taken. Only valid
+ * while the ring holds no data, so that nothing overtakes it; the slow path
+ * may use it under the same condition. The bytes are counted in userLen,
+ * and TCPIn completes the receive with userLen as it would after copying
+ * from the ring. The caller still advances recvNext by the whole segment.
+ * Only TCPPredictIn calls it in this tree, so no payload is placed until
+ * the core's TCPIn or its slow path does. */
+s32 TCPPredictPlace(TCPInfo* tcp, const u8* data, s32 len) {
+    s32 n;
+
+    if (tcp->userData == NULL || tcp->recvUser != 0) {
+        return 0;
+    }
+
+    n = tcp->userBuff - tcp->userLen;
+    if (len < n) {
+        n = len;
+    }
+
+    if (0 < n) {
+        memmove(tcp->userData + tcp->userLen, data, n);
+        tcp->userLen += n;
+        Stat.placedBytes += n;
+    }
+    return n;
+}
+
+/* Called by TCPIn as it returns, with the result of TCPPredictIn and the
+ * OSGetTick() value taken on entry, so the cost of each path can be
+ * compared. Pure ACKs and data segments share the fast path total. */
+void TCPPredictAccount(s32 result, OSTick start) {
+    u32 ticks;
+
+    ticks = OSGetTick() - start;
+    if (result == TCP_PREDICT_NONE) {
+        Stat.slowSegs++;
+        Stat.slowTicks += ticks;
+    } else {
+        Stat.fastTicks += ticks;
+    }
+}
+
+/* Ticks are of the time base; one is OS_CORE_CLOCK / OS_TIMER_CLOCK CPU
+ * cycles. Cycles per segment on the fast path are
+ * fastTicks * 12 / (ackSegs + dataSegs) on GameCube. */
+void TCPPredictGetStat(TCPPredictStat* stat) {
+    BOOL enabled;
+
+    enabled = OSDisableInterrupts();
+    memmove(stat, &Stat, sizeof(TCPPredictStat));
+    OSRestoreInterrupts(enabled);
+}
+
+void TCPPredictResetStat(void) {
+    BOOL enabled;
+
+    enabled = OSDisableInterrupts();
+    memset(&Stat, 0, sizeof(TCPPredictStat));
+    OSRestoreInterrupts(enabled);
+}
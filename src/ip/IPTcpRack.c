@@ -0,0 +1,351 @@
+#include <dolphin/ip/IPTcpRack.h>
+#include <dolphin/private/ip.h>
+
+#ifdef NULL
+#undef NULL
+#endif
+
+#define NULL 0
+
+/*
+ * RACK-TLP (RFC 8985). Every transmitted segment is recorded with its send
+ * time in a per-connection list kept in transmission order; a
+ * retransmission moves its record to the tail. A segment is deemed lost
+ * once a segment sent after it has been delivered and more than
+ * RACK.rtt + reoWnd have passed since it was sent, so losses are detected
+ * from time rather than from a count of duplicate ACKs. When the tail of a
+ * flight is lost and no further ACKs arrive, a tail loss probe after about
+ * two round trips elicits the ACK that lets RACK repair it, instead of
+ * waiting for the retransmission timeout.
+ *
+ * This is library code for the TCP core, which is not in this tree: TCPOut
+ * would call TCPRackSent for every segment, TCPIn TCPRackAck for every ACK,
+ * the retransmission timer TCPRackRto, and the core would register its
+ * output routine with TCPRackSetOutput. Until then the lists stay empty and
+ * rackAlarm is never armed; IPSocket.c only calls TCPRackInit and
+ * TCPRackClear.
+ */
+
+static TCPRackSeg Pool[TCP_RACK_SEG_NUM]; // size: 0x4000
+static IFQueue Free;
+static TCPRackOutput Output;
+
+static void RackTimeout(IPTimer* alarm);
+
+void TCPRackInit(void) {
+    int i;
+    BOOL enabled;
+
+    enabled = OSDisableInterrupts();
+    IFQueueInit(&Free);
+    for (i = 0; i < TCP_RACK_SEG_NUM; i++) {
+        IFQueueEnqueueTail(TCPRackSeg*, &Free, &Pool[i]);
+    }
+    OSRestoreInterrupts(enabled);
+}
+
+/* Registers the TCP output routine the RACK timer calls to retransmit
+ * segments it has marked lost or to send a tail loss probe. */
+void TCPRackSetOutput(TCPRackOutput output) {
+    Output = output;
+}
+
+static void FreeSeg(TCPInfo* tcp, TCPRackSeg* seg) {
+    IFQueueDequeueEntry(TCPRackSeg*, &tcp->rackList, seg);
+    if (seg->flag & TCP_RACK_LOST) {
+        tcp->rackLost -= seg->end - seg->start;
+    }
+    IFQueueEnqueueHead(TCPRackSeg*, &Free, seg);
+}
+
+static void SetTimer(TCPInfo* tcp, s32 mode, OSTime delay) {
+    tcp->rackTimer = mode;
+    if (mode != TCP_RACK_TIMER_NONE) {
+        IPTimerSet(&tcp->rackAlarm, delay, RackTimeout);
+    } else {
+        IPTimerCancel(&tcp->rackAlarm);
+    }
+}
+
+/* Reordering window: a quarter of the minimum RTT, never above srtt */
+static OSTime ReoWnd(TCPInfo* tcp) {
+    OSTime reo;
+
+    reo = tcp->rttMin / 4;
+    if (0 < tcp->srtt && tcp->srtt < reo) {
+        reo = tcp->srtt;
+    }
+    return reo;
+}
+
+/* Schedules a tail loss probe for the current flight. Only one probe is
+ * sent per flight; if the probe timeout would not beat the retransmission
+ * timeout the probe is skipped and rxmitAlarm handles the flight. The
+ * flight is the records in rackList: TCPRackSent runs before sendMax
+ * covers the segment, and TCPRackAck has freed those below sendUna. */
+static void ArmPto(TCPInfo* tcp) {
+    OSTime pto;
+
+    if (tcp->tlpPending || tcp->rackList.next == NULL) {
+        if (tcp->rackTimer == TCP_RACK_TIMER_TLP) {
+            SetTimer(tcp, TCP_RACK_TIMER_NONE, 0);
+        }
+        return;
+    }
+
+    if (0 < tcp->srtt) {
+        pto = 2 * tcp->srtt;
+        if (tcp->sendMax - tcp->sendUna <= tcp->mss) {
+            pto += TCP_RACK_DACK_MAX;
+        }
+    } else {
+        pto = TCP_RACK_PTO_INIT;
+    }
+
+    if (0 < tcp->rto && tcp->rto <= pto) {
+        if (tcp->rackTimer == TCP_RACK_TIMER_TLP) {
+            SetTimer(tcp, TCP_RACK_TIMER_NONE, 0);
+        }
+        return;
+    }
+
+    SetTimer(tcp, TCP_RACK_TIMER_TLP, pto);
+}
+
+/* Marks as lost every outstanding segment sent sufficiently long before
+ * the most recently delivered one, and arms the reordering timer for those
+ * that are not yet overdue. */
+static void DetectLoss(TCPInfo* tcp, OSTime now) {
+    TCPRackSeg* seg;
+    OSTime reo;
+    OSTime remaining;
+    OSTime timeout;
+
+    if (tcp->rackXmit == 0) {
+        return;
+    }
+
+    reo = ReoWnd(tcp);
+    timeout = 0;
+    for (seg = (TCPRackSeg*)tcp->rackList.next; seg != NULL; seg = (TCPRackSeg*)seg->link.next) {
+        if (seg->flag & (TCP_RACK_SACKED | TCP_RACK_LOST)) {
+            continue;
+        }
+
+        /* The list is in transmission order, so nothing further on was sent
+         * before the delivered segment either */
+        if (tcp->rackXmit < seg->xmit || (tcp->rackXmit == seg->xmit && !TCP_SEQ_LT(seg->end, tcp->rackEndSeq))) {
+            break;
+        }
+
+        remaining = seg->xmit + tcp->rackRtt + reo - now;
+        if (remaining <= 0) {
+            seg->flag |= TCP_RACK_LOST;
+            tcp->rackLost += seg->end - seg->start;
+        } else if (timeout < remaining) {
+            timeout = remaining;
+        }
+    }
+
+    if (0 < timeout) {
+        SetTimer(tcp, TCP_RACK_TIMER_REO, timeout);
+    } else if (tcp->rackTimer == TCP_RACK_TIMER_REO) {
+        SetTimer(tcp, TCP_RACK_TIMER_NONE, 0);
+    }
+}
+
+static void RackTimeout(IPTimer* alarm) {
+    TCPInfo* tcp;
+    s32 mode;
+
+    tcp = (TCPInfo*)(((u8*)alarm) - offsetof(TCPInfo, rackAlarm));
+    mode = tcp->rackTimer;
+    tcp->rackTimer = TCP_RACK_TIMER_NONE;
+
+    if (mode == TCP_RACK_TIMER_REO) {
+        DetectLoss(tcp, OSGetTime());
+        if (0 < tcp->rackLost && Output != NULL) {
+            Output(tcp, FALSE);
+        }
+    } else if (mode == TCP_RACK_TIMER_TLP) {
+        tcp->tlpPending = TRUE;
+        if (Output != NULL) {
+            Output(tcp, TRUE);
+        }
+        tcp->tlpHighSeq = tcp->sendMax;
+    }
+
+    if (tcp->rackTimer == TCP_RACK_TIMER_NONE) {
+        ArmPto(tcp);
+    }
+}
+
+/* Called by the TCP output path with interrupts disabled for each segment
+ * [seq, seq + len) handed to IPOut, before sendMax is advanced past it. */
+void TCPRackSent(TCPInfo* tcp, s32 seq, s32 len) {
+    TCPRackSeg* seg;
+
+    if (len <= 0) {
+        return;
+    }
+
+    if (TCP_SEQ_LT(seq, tcp->sendMax)) {
+        for (seg = (TCPRackSeg*)tcp->rackList.next; seg != NULL; seg = (TCPRackSeg*)seg->link.next) {
+            if (TCP_SEQ_LEQ(seg->start, seq) && TCP_SEQ_LT(seq, seg->end)) {
+                break;
+            }
+        }
+
+        if (seg == NULL) {
+            return;
+        }
+
+        if (seg->flag & TCP_RACK_LOST) {
+            tcp->rackLost -= seg->end - seg->start;
+        }
+        seg->flag = (seg->flag & ~TCP_RACK_LOST) | TCP_RACK_RXMIT;
+        seg->xmit = OSGetTime();
+        IFQueueDequeueEntry(TCPRackSeg*, &tcp->rackList, seg);
+        IFQueueEnqueueTail(TCPRackSeg*, &tcp->rackList, seg);
+        return;
+    }
+
+    if (Free.next == NULL) {
+        /* Out of records: the segment goes untracked and a loss of it is
+         * recovered by duplicate ACKs or timeout as before */
+        return;
+    }
+
+    IFQueueDequeueHead(TCPRackSeg*, &Free, seg);
+    seg->start = seq;
+    seg->end = seq + len;
+    seg->xmit = OSGetTime();
+    seg->flag = 0;
+    IFQueueEnqueueTail(TCPRackSeg*, &tcp->rackList, seg);
+
+    if (tcp->rackTimer != TCP_RACK_TIMER_REO) {
+        ArmPto(tcp);
+    }
+}
+
+static void Deliver(TCPInfo* tcp, TCPRackSeg* seg, OSTime now) {
+    OSTime rtt;
+
+    rtt = now - seg->xmit;
+    if ((seg->flag & TCP_RACK_RXMIT) && rtt < tcp->rttMin) {
+        /* Too quick to be for the retransmission; it acknowledges the
+         * original transmission, whose send time is gone */
+        return;
+    }
+
+    if (tcp->rackXmit < seg->xmit || (tcp->rackXmit == seg->xmit && TCP_SEQ_LT(tcp->rackEndSeq, seg->end))) {
+        tcp->rackXmit = seg->xmit;
+        tcp->rackEndSeq = seg->end;
+        tcp->rackRtt = rtt;
+    }
+}
+
+/* Called by TCPIn with interrupts disabled once an ACK has been processed,
+ * i.e. after sendUna has been advanced and the SACK scoreboard updated.
+ * Returns the number of bytes marked lost and not yet retransmitted; the
+ * caller retransmits them in TCPRackNextLost order. */
+s32 TCPRackAck(TCPInfo* tcp) {
+    TCPRackSeg* seg;
+    TCPRackSeg* next;
+    OSTime now;
+
+    now = OSGetTime();
+    for (seg = (TCPRackSeg*)tcp->rackList.next; seg != NULL; seg = next) {
+        next = (TCPRackSeg*)seg->link.next;
+        if (TCP_SEQ_LEQ(seg->end, tcp->sendUna)) {
+            Deliver(tcp, seg, now);
+            FreeSeg(tcp, seg);
+        } else if (!(seg->flag & TCP_RACK_SACKED) && TCPSackIsSacked(tcp, seg->start) && TCPSackIsSacked(tcp, seg->end - 1)) {
+            Deliver(tcp, seg, now);
+            if (seg->flag & TCP_RACK_LOST) {
+                tcp->rackLost -= seg->end - seg->start;
+            }
+            seg->flag = (seg->flag & ~TCP_RACK_LOST) | TCP_RACK_SACKED;
+        }
+    }
+
+    if (tcp->tlpPending && TCP_SEQ_LEQ(tcp->tlpHighSeq, tcp->sendUna)) {
+        tcp->tlpPending = FALSE;
+    }
+
+    DetectLoss(tcp, now);
+    if (tcp->rackTimer != TCP_RACK_TIMER_REO) {
+        ArmPto(tcp);
+    }
+
+    return tcp->rackLost;
+}
+
+/* On a retransmission timeout every outstanding segment not SACKed is
+ * considered lost */
+void TCPRackRto(TCPInfo* tcp) {
+    TCPRackSeg* seg;
+    BOOL enabled;
+
+    enabled = OSDisableInterrupts();
+    for (seg = (TCPRackSeg*)tcp->rackList.next; seg != NULL; seg = (TCPRackSeg*)seg->link.next) {
+        if (!(seg->flag & (TCP_RACK_SACKED | TCP_RACK_LOST))) {
+            seg->flag |= TCP_RACK_LOST;
+            tcp->rackLost += seg->end - seg->start;
+        }
+    }
+    tcp->tlpPending = FALSE;
+    SetTimer(tcp, TCP_RACK_TIMER_NONE, 0);
+    OSRestoreInterrupts(enabled);
+}
+
+/* Returns the oldest segment marked lost, or FALSE if there is none */
+BOOL TCPRackNextLost(TCPInfo* tcp, s32* start, s32* end) {
+    TCPRackSeg* seg;
+
+    for (seg = (TCPRackSeg*)tcp->rackList.next; seg != NULL; seg = (TCPRackSeg*)seg->link.next) {
+        if (seg->flag & TCP_RACK_LOST) {
+            *start = TCP_SEQ_LT(seg->start, tcp->sendUna) ? tcp->sendUna : seg->start;
+            *end = seg->end;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Returns the highest unSACKed segment sent, which a tail loss probe
+ * retransmits when there is no new data to send */
+BOOL TCPRackProbeRange(TCPInfo* tcp, s32* start, s32* end) {
+    TCPRackSeg* seg;
+    TCPRackSeg* high;
+
+    high = NULL;
+    for (seg = (TCPRackSeg*)tcp->rackList.next; seg != NULL; seg = (TCPRackSeg*)seg->link.next) {
+        if (!(seg->flag & TCP_RACK_SACKED) && (high == NULL || TCP_SEQ_LT(high->end, seg->end))) {
+            high = seg;
+        }
+    }
+
+    if (high == NULL) {
+        return FALSE;
+    }
+
+    *start = TCP_SEQ_LT(high->start, tcp->sendUna) ? tcp->sendUna : high->start;
+    *end = high->end;
+    return TRUE;
+}
+
+void TCPRackClear(TCPInfo* tcp) {
+    BOOL enabled;
+
+    enabled = OSDisableInterrupts();
+    SetTimer(tcp, TCP_RACK_TIMER_NONE, 0);
+    while (tcp->rackList.next != NULL) {
+        FreeSeg(tcp, (TCPRackSeg*)tcp->rackList.next);
+    }
+    tcp->rackLost = 0;
+    tcp->rackXmit = 0;
+    tcp->tlpPending = FALSE;
+    OSRestoreInterrupts(enabled);
+}
@@ -0,0 +1,273 @@
+#include <dolphin/ip/IPTcpSack.h>
+#include <dolphin/private/ip.h>
+
+#ifdef NULL
+#undef NULL
+#endif
+
+#define NULL 0
+
+/*
+ * Sender scoreboard. Each connection keeps the blocks its peer has SACKed
+ * above sendUna as a list sorted by sequence number, with overlapping and
+ * adjacent blocks merged. New SACK information nearly always lands at or
+ * near the top of the window, so lookups start from the tail. Blocks come
+ * from a shared pool rather than a fixed per-connection array.
+ */
+
+static TCPSackBlock Pool[TCP_SACK_BLOCK_NUM]; // size: 0x2000
+static IFQueue Free;
+
+void TCPSackInit(void) {
+    int i;
+    BOOL enabled;
+
+    enabled = OSDisableInterrupts();
+    IFQueueInit(&Free);
+    for (i = 0; i < TCP_SACK_BLOCK_NUM; i++) {
+        IFQueueEnqueueTail(TCPSackBlock*, &Free, &Pool[i]);
+    }
+    OSRestoreInterrupts(enabled);
+}
+
+static void FreeBlock(TCPInfo* tcp, TCPSackBlock* block) {
+    IFQueueDequeueEntry(TCPSackBlock*, &tcp->sackList, block);
+    tcp->sackBytes -= block->end - block->start;
+    tcp->sackCount--;
+    IFQueueEnqueueHead(TCPSackBlock*, &Free, block);
+}
+
+/* Records the SACK block [start, end) from an incoming ACK. Must be called
+ * with interrupts disabled. */
+void TCPSackUpdate(TCPInfo* tcp, s32 start, s32 end) {
+    TCPSackBlock* block;
+    TCPSackBlock* prev;
+    TCPSackBlock* next;
+
+    if (TCP_SEQ_LT(start, tcp->sendUna)) {
+        start = tcp->sendUna;
+    }
+
+    if (!TCP_SEQ_LT(start, end) || TCP_SEQ_LT(tcp->sendMax, end)) {
+        return;
+    }
+
+    /* Last block starting at or below end */
+    for (block = (TCPSackBlock*)tcp->sackList.prev; block != NULL; block = (TCPSackBlock*)block->link.prev) {
+        if (TCP_SEQ_LEQ(block->start, end)) {
+            break;
+        }
+    }
+
+    if (block != NULL && TCP_SEQ_LEQ(start, block->end)) {
+        tcp->sackBytes -= block->end - block->start;
+        if (TCP_SEQ_LT(block->end, end)) {
+            block->end = end;
+        }
+
+        if (TCP_SEQ_LT(start, block->start)) {
+            block->start = start;
+
+            /* Absorb the blocks the extension now reaches */
+            while ((prev = (TCPSackBlock*)block->link.prev) != NULL && TCP_SEQ_LEQ(block->start, prev->end)) {
+                if (TCP_SEQ_LT(prev->start, block->start)) {
+                    block->start = prev->start;
+                }
+                FreeBlock(tcp, prev);
+            }
+        }
+
+        tcp->sackBytes += block->end - block->start;
+        return;
+    }
+
+    if (Free.next == NULL) {
+        /* Out of blocks: forget this one, the hole below it is then
+         * recovered by timeout as before */
+        return;
+    }
+
+    IFQueueDequeueHead(TCPSackBlock*, &Free, next);
+    next->start = start;
+    next->end = end;
+    if (block == NULL) {
+        IFQueueEnqueueHead(TCPSackBlock*, &tcp->sackList, next);
+    } else if (block->link.next == NULL) {
+        IFQueueEnqueueTail(TCPSackBlock*, &tcp->sackList, next);
+    } else {
+        next->link.prev = (IFQueue*)block;
+        next->link.next = block->link.next;
+        ((TCPSackBlock*)block->link.next)->link.prev = (IFQueue*)next;
+        block->link.next = (IFQueue*)next;
+    }
+
+    tcp->sackBytes += end - start;
+    tcp->sackCount++;
+}
+
+/* Drops scoreboard state below sendUna after a cumulative ACK */
+void TCPSackAdvance(TCPInfo* tcp) {
+    TCPSackBlock* block;
+
+    while ((block = (TCPSackBlock*)tcp->sackList.next) != NULL) {
+        if (TCP_SEQ_LEQ(block->end, tcp->sendUna)) {
+            FreeBlock(tcp, block);
+        } else {
+            if (TCP_SEQ_LT(block->start, tcp->sendUna)) {
+                tcp->sackBytes -= tcp->sendUna - block->start;
+                block->start = tcp->sendUna;
+            }
+            break;
+        }
+    }
+}
+
+/* Forgets all SACK information, e.g. after a retransmission timeout */
+void TCPSackClear(TCPInfo* tcp) {
+    BOOL enabled;
+
+    enabled = OSDisableInterrupts();
+    while (tcp->sackList.next != NULL) {
+        FreeBlock(tcp, (TCPSackBlock*)tcp->sackList.next);
+    }
+    tcp->sackBytes = 0;
+    tcp->sackCount = 0;
+    OSRestoreInterrupts(enabled);
+}
+
+/* Finds the first unSACKed range at or above seq and below the highest SACKed
+ * sequence number. Returns FALSE if there is none. */
+BOOL TCPSackNextHole(TCPInfo* tcp, s32 seq, s32* start, s32* end) {
+    TCPSackBlock* block;
+    s32 hole;
+
+    hole = tcp->sendUna;
+    if (TCP_SEQ_LT(hole, seq)) {
+        hole = seq;
+    }
+
+    for (block = (TCPSackBlock*)tcp->sackList.next; block != NULL; block = (TCPSackBlock*)block->link.next) {
+        if (TCP_SEQ_LT(hole, block->start)) {
+            *start = hole;
+            *end = block->start;
+            return TRUE;
+        }
+
+        if (TCP_SEQ_LT(hole, block->end)) {
+            hole = block->end;
+        }
+    }
+
+    return FALSE;
+}
+
+/* RFC 6675 IsLost: seq is lost once DupThresh discontiguous blocks or more
+ * than (DupThresh - 1) segments' worth of data above it have been SACKed */
+BOOL TCPSackIsLost(TCPInfo* tcp, s32 seq) {
+    TCPSackBlock* block;
+    s32 bytes;
+    int count;
+
+    bytes = 0;
+    count = 0;
+    for (block = (TCPSackBlock*)tcp->sackList.prev; block != NULL && TCP_SEQ_LT(seq, block->end); block = (TCPSackBlock*)block->link.prev) {
+        bytes += block->end - (TCP_SEQ_LT(seq, block->start) ? block->start : seq);
+        if (TCP_SACK_DUPTHRESH <= ++count || (TCP_SACK_DUPTHRESH - 1) * tcp->mss < bytes) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+BOOL TCPSackIsSacked(TCPInfo* tcp, s32 seq) {
+    TCPSackBlock* block;
+
+    for (block = (TCPSackBlock*)tcp->sackList.prev; block != NULL; block = (TCPSackBlock*)block->link.prev) {
+        if (TCP_SEQ_LEQ(block->start, seq)) {
+            return TCP_SEQ_LT(seq, block->end);
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * Receiver side. Out-of-order data is written straight into the receive
+ * ring and its extents are kept in TCPInfo.asb, the table TCPIn in the TCP
+ * core fills, from least to most recently received (see IFRingInEx).
+ */
+
+void TCPSackInitRecv(TCPInfo* tcp) {
+    memset(tcp->asb, 0, sizeof(tcp->asb));
+}
+
+BOOL TCPSackHasHoles(TCPInfo* tcp) {
+    return tcp->asb[0].ptr != NULL;
+}
+
+/* Copies the segment [seq, seq + len) into the receive ring, which must have
+ * room for it. Returns the number of bytes that became contiguous with
+ * recvNext, which the caller hands to the user, 0 if the segment was held
+ * out of order, or -1 if it was dropped because every block is in use. */
+s32 TCPSackQueue(TCPInfo* tcp, s32 seq, const u8* data, s32 len) {
+    s32 adv;
+
+    adv = len;
+    IFRingInBlock(tcp->recvData, tcp->recvBuff, tcp->recvPtr, tcp->recvUser, seq - tcp->recvNext, data, &adv, tcp->asb,
+                  TCP_SACK_ASB_NUM);
+    return adv;
+}
+
+static s32 GetBlockSeq(TCPInfo* tcp, u8* tail, IFBlock* block) {
+    s32 offset;
+
+    offset = (s32)block->ptr - (s32)tail;
+    if (offset < 0) {
+        offset += tcp->recvBuff;
+    }
+    return tcp->recvNext + offset;
+}
+
+static void PutBlock(TCPInfo* tcp, u8* tail, IFBlock* block, u8* opt) {
+    s32 seq;
+
+    seq = GetBlockSeq(tcp, tail, block);
+    memmove(opt, &seq, 4);
+    seq += block->len;
+    memmove(opt + 4, &seq, 4);
+}
+
+/*
+ * Builds a SACK option (RFC 2018) describing the out-of-order data held in
+ * the receive ring, most recently received block first, as the RFC
+ * requires. Returns the option length, a multiple of 4.
+ */
+s32 TCPSackBuildOption(TCPInfo* tcp, u8* opt, s32 len) {
+    u8* tail;
+    int n;
+    int i;
+
+    if (tcp->recvData == NULL || len < 12 || !TCPSackHasHoles(tcp)) {
+        return 0;
+    }
+
+    tail = tcp->recvPtr + tcp->recvUser;
+    if (tcp->recvData + tcp->recvBuff <= tail) {
+        tail -= tcp->recvBuff;
+    }
+
+    for (i = 0; i < TCP_SACK_ASB_NUM && tcp->asb[i].ptr != NULL; i++) {
+        ;
+    }
+
+    for (n = 0; 0 < i && 4 + 8 * (n + 1) <= len; n++) {
+        PutBlock(tcp, tail, &tcp->asb[--i], opt + 4 + 8 * n);
+    }
+
+    opt[0] = TCP_OPT_NOP;
+    opt[1] = TCP_OPT_NOP;
+    opt[2] = TCP_OPT_SACK;
+    opt[3] = (u8)(2 + 8 * n);
+    return 4 + 8 * n;
+}
@@ -0,0 +1,208 @@
+#include <dolphin/ip/IPTcpTimeWait.h>
+#include <dolphin/private/ip.h>
+
+#ifdef NULL
+#undef NULL
+#endif
+
+#define NULL 0
+
+/*
+ * TIME_WAIT table. Connections in TIME_WAIT are kept as minimal records,
+ * the 4-tuple and an expiry time, in the buffer given to
+ * TCPSetTimeWaitTable (SOConfig.timeWaitBuffer bytes). The buffer holds a
+ * power-of-two array of hash chains followed by the records, so lookups
+ * take constant time however many connections are waiting.
+ *
+ * Every record lives for TCP_TIMEWAIT_TIME, so expiry order is insertion
+ * order. Records are used as a ring: the oldest is at Head, and one timer
+ * on the wheel is armed for its expiry. When the ring is full the oldest
+ * record is retired early, as RFC 6191 allows once its peer has moved on.
+ *
+ * SOStartup hands the table SOConfig.timeWaitBuffer in place of the TCP
+ * core's flat buffer, __SOClose records a connection as it closes first
+ * from ESTABLISHED, and IPConnect checks the table before taking a tuple.
+ */
+
+static u16* Hash;
+static TCPTimeWaitEntry* Table;
+static s32 HashMask;
+static s32 Num;
+static s32 Head;
+static s32 Count;
+static u32 Salt;
+static IPTimer Alarm;
+
+static u32 GetMs(void) {
+    return (u32)OSTicksToMilliseconds(OSGetTime());
+}
+
+static s32 GetBucket(const u8* src, u16 srcPort, const u8* dst, u16 dstPort) {
+    u32 h;
+
+    h = IPU32(src) ^ Salt;
+    h = (h ^ IPU32(dst)) * 0x9E3779B1;
+    h = (h ^ ((u32)srcPort << 16 | dstPort)) * 0x85EBCA6B;
+    h ^= h >> 16;
+    return (s32)(h & HashMask);
+}
+
+static TCPTimeWaitEntry* Find(const u8* src, u16 srcPort, const u8* dst, u16 dstPort) {
+    TCPTimeWaitEntry* entry;
+    u16 i;
+
+    for (i = Hash[GetBucket(src, srcPort, dst, dstPort)]; i != TCP_TIMEWAIT_NIL; i = entry->next) {
+        entry = &Table[i];
+        if (entry->srcPort == srcPort && entry->dstPort == dstPort && IPEQ(entry->src, src) && IPEQ(entry->dst, dst)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* Takes the entry off its chain. The ring slot stays in use until Head
+ * reaches it. */
+static void Unlink(TCPTimeWaitEntry* entry) {
+    u16* prev;
+    u16 i;
+
+    if (entry->srcPort == 0) {
+        return;
+    }
+
+    i = (u16)(entry - Table);
+    for (prev = &Hash[entry->bucket]; *prev != TCP_TIMEWAIT_NIL; prev = &Table[*prev].next) {
+        if (*prev == i) {
+            *prev = entry->next;
+            break;
+        }
+    }
+    entry->srcPort = 0;
+}
+
+static void Retire(void) {
+    Unlink(&Table[Head]);
+    if (++Head == Num) {
+        Head = 0;
+    }
+    Count--;
+}
+
+static void TimeoutCallback(IPTimer* timer) {
+    u32 now;
+
+    now = GetMs();
+    while (0 < Count && (Table[Head].srcPort == 0 || (s32)(Table[Head].expire - now) <= 0)) {
+        Retire();
+    }
+
+    if (0 < Count) {
+        IPTimerSet(timer, OSMillisecondsToTicks((OSTime)(Table[Head].expire - now)), TimeoutCallback);
+    }
+}
+
+/* buf is NULL to keep no TIME_WAIT state */
+void TCPSetTimeWaitTable(void* buf, s32 size) {
+    BOOL enabled;
+    s32 buckets;
+    s32 i;
+
+    enabled = OSDisableInterrupts();
+    IPTimerCancel(&Alarm);
+    Hash = NULL;
+    Table = NULL;
+    HashMask = Num = Head = Count = 0;
+
+    /* About two records per chain */
+    if (buf != NULL && (s32)(2 * sizeof(u16) + sizeof(TCPTimeWaitEntry)) <= size) {
+        for (buckets = 1; 2 * buckets * (s32)(2 * sizeof(u16) + sizeof(TCPTimeWaitEntry)) <= size; buckets *= 2) {
+            ;
+        }
+
+        Hash = (u16*)buf;
+        Table = (TCPTimeWaitEntry*)((u8*)buf + ((buckets * sizeof(u16) + 3) & ~3));
+        Num = (s32)(((u8*)buf + size - (u8*)Table) / (s32)sizeof(TCPTimeWaitEntry));
+        if (TCP_TIMEWAIT_NUM_MAX < Num) {
+            Num = TCP_TIMEWAIT_NUM_MAX;
+        }
+
+        HashMask = buckets - 1;
+        for (i = 0; i < buckets; i++) {
+            Hash[i] = TCP_TIMEWAIT_NIL;
+        }
+        Salt = OSGetTick();
+    }
+    OSRestoreInterrupts(enabled);
+}
+
+/* Called as a connection heads for TIME_WAIT, so its TCPInfo can be
+ * released at once. Returns FALSE if no table was configured. */
+BOOL TCPEnterTimeWait(const u8* src, u16 srcPort, const u8* dst, u16 dstPort) {
+    BOOL enabled;
+    TCPTimeWaitEntry* entry;
+    s32 bucket;
+
+    enabled = OSDisableInterrupts();
+    if (Num == 0) {
+        OSRestoreInterrupts(enabled);
+        return FALSE;
+    }
+
+    entry = Find(src, srcPort, dst, dstPort);
+    if (entry != NULL) {
+        Unlink(entry);
+    }
+
+    if (Count == Num) {
+        Retire();
+    }
+
+    entry = &Table[(Head + Count) % Num];
+    bucket = GetBucket(src, srcPort, dst, dstPort);
+    memmove(entry->src, src, 4);
+    memmove(entry->dst, dst, 4);
+    entry->srcPort = srcPort;
+    entry->dstPort = dstPort;
+    entry->bucket = (u16)bucket;
+    entry->expire = GetMs() + (u32)OSTicksToMilliseconds(TCP_TIMEWAIT_TIME);
+    entry->next = Hash[bucket];
+    Hash[bucket] = (u16)(entry - Table);
+    if (Count++ == 0) {
+        IPTimerSet(&Alarm, TCP_TIMEWAIT_TIME, TimeoutCallback);
+    }
+    OSRestoreInterrupts(enabled);
+    return TRUE;
+}
+
+/* Ends TIME_WAIT early, e.g. when a new SYN may reuse the tuple */
+BOOL TCPRemoveTimeWait(const u8* src, u16 srcPort, const u8* dst, u16 dstPort) {
+    BOOL enabled;
+    TCPTimeWaitEntry* entry;
+
+    enabled = OSDisableInterrupts();
+    entry = (Num != 0) ? Find(src, srcPort, dst, dstPort) : NULL;
+    if (entry != NULL) {
+        Unlink(entry);
+    }
+    OSRestoreInterrupts(enabled);
+    return (entry != NULL) ? TRUE : FALSE;
+}
+
+BOOL TCPLookupTimeWait(const u8* src, u16 srcPort, const u8* dst, u16 dstPort) {
+    BOOL enabled;
+    TCPTimeWaitEntry* entry;
+
+    enabled = OSDisableInterrupts();
+    entry = (Num != 0) ? Find(src, srcPort, dst, dstPort) : NULL;
+    if (entry != NULL && (s32)(entry->expire - GetMs()) <= 0) {
+        entry = NULL;
+    }
+    OSRestoreInterrupts(enabled);
+    return (entry != NULL) ? TRUE : FALSE;
+}
+
+/* Records in the ring, including ones removed early but not yet reached by
+ * the timer */
+s32 TCPGetTimeWaitCount(void) {
+    return Count;
+}
@@ -0,0 +1,209 @@
+#include <dolphin/ip/IPTimer.h>
+#include <dolphin/private/ip.h>
+
+#ifdef NULL
+#undef NULL
+#endif
+
+#define NULL 0
+
+/*
+ * Hashed timer wheel. Timers are hashed by expiry tick into IP_TIMER_SLOTS
+ * lists, visited one per IP_TIMER_TICK. A single one-shot OS alarm is set for
+ * the next slot that holds a timer, so empty ticks cost nothing and the alarm
+ * is idle while no timer is pending. Timers further out than one revolution
+ * stay in their slot until a visit finds them due. Arming and cancelling are
+ * O(1). Pushing an armed timer later, which is what a retransmission timer
+ * does on every ACK, only updates its expiry: the timer is moved when its
+ * old slot comes round.
+ *
+ * Handlers run from the alarm in interrupt context and may arm or cancel
+ * any timer, including their own.
+ */
+
+static IFQueue Wheel[IP_TIMER_SLOTS];
+static IFQueue Firing;
+static OSAlarm Alarm;
+static BOOL AlarmCreated;
+static BOOL AlarmSet;
+static BOOL Running; // in TickCallback
+static OSTime Tick; // next tick to visit
+static OSTime Next; // tick the alarm is set for; slots before it are empty
+static int Count; // timers on the wheel or in Firing
+
+static void TickCallback(OSAlarm* alarm, OSContext* context);
+
+static OSTime GetTick(OSTime time) {
+    return (time + IP_TIMER_TICK - 1) / IP_TIMER_TICK;
+}
+
+static void Insert(IPTimer* timer, OSTime tick) {
+    if (tick < Tick) {
+        tick = Tick;
+    }
+
+    timer->slot = (s32)(tick & (IP_TIMER_SLOTS - 1)) + 1;
+    IFQueueEnqueueTail(IPTimer*, &Wheel[timer->slot - 1], timer);
+}
+
+/* Sets the alarm to visit the slots up to tick. Must be called with
+ * interrupts disabled. */
+static void SetAlarm(OSTime tick, OSTime now) {
+    OSTime delay;
+
+    if (!AlarmCreated) {
+        OSCreateAlarm(&Alarm);
+        AlarmCreated = TRUE;
+    }
+
+    if (AlarmSet) {
+        OSCancelAlarm(&Alarm);
+    }
+
+    delay = tick * IP_TIMER_TICK - now;
+    OSSetAlarm(&Alarm, (0 < delay) ? delay : 1, TickCallback);
+    Next = tick;
+    AlarmSet = TRUE;
+}
+
+/* Sets the alarm for the first slot from Tick on that holds a timer */
+static void Schedule(OSTime now) {
+    s32 n;
+
+    for (n = 0; n < IP_TIMER_SLOTS - 1; n++) {
+        if (Wheel[(Tick + n) & (IP_TIMER_SLOTS - 1)].next != NULL) {
+            break;
+        }
+    }
+
+    SetAlarm(Tick + n, now);
+}
+
+void IPTimerCreate(IPTimer* timer) {
+    timer->link.next = timer->link.prev = NULL;
+    timer->expire = 0;
+    timer->handler = NULL;
+    timer->slot = IP_TIMER_IDLE;
+}
+
+void IPTimerSet(IPTimer* timer, OSTime delay, IPTimerHandler handler) {
+    BOOL enabled;
+    OSTime now;
+    OSTime tick;
+    OSTime visit;
+
+    enabled = OSDisableInterrupts();
+    now = OSGetTime();
+    if (!Running && (Count == 0 || now / IP_TIMER_TICK < Next)) {
+        /* Every slot up to now is empty; skip them */
+        if (Tick <= now / IP_TIMER_TICK) {
+            Tick = now / IP_TIMER_TICK + 1;
+        }
+    }
+
+    timer->expire = now + ((0 < delay) ? delay : 1);
+    timer->handler = handler;
+    tick = GetTick(timer->expire);
+
+    if (0 < timer->slot) {
+        /* Still on the wheel: leave it where it is unless its slot would be
+         * visited too late */
+        visit = Tick + ((timer->slot - 1 - Tick) & (IP_TIMER_SLOTS - 1));
+        if (visit <= tick) {
+            OSRestoreInterrupts(enabled);
+            return;
+        }
+        IFQueueDequeueEntry(IPTimer*, &Wheel[timer->slot - 1], timer);
+    } else if (timer->slot == IP_TIMER_FIRING) {
+        IFQueueDequeueEntry(IPTimer*, &Firing, timer);
+    } else {
+        Count++;
+    }
+
+    Insert(timer, tick);
+    if (!Running && (!AlarmSet || tick < Next)) {
+        SetAlarm((tick < Tick) ? Tick : tick, now);
+    }
+    OSRestoreInterrupts(enabled);
+}
+
+void IPTimerCancel(IPTimer* timer) {
+    BOOL enabled;
+
+    enabled = OSDisableInterrupts();
+    timer->expire = 0;
+    if (0 < timer->slot) {
+        IFQueueDequeueEntry(IPTimer*, &Wheel[timer->slot - 1], timer);
+    } else if (timer->slot == IP_TIMER_FIRING) {
+        IFQueueDequeueEntry(IPTimer*, &Firing, timer);
+    } else {
+        OSRestoreInterrupts(enabled);
+        return;
+    }
+
+    timer->slot = IP_TIMER_IDLE;
+    if (--Count == 0 && AlarmSet && !Running) {
+        OSCancelAlarm(&Alarm);
+        AlarmSet = FALSE;
+    }
+    OSRestoreInterrupts(enabled);
+}
+
+/* Sorts one slot: due timers move to Firing and the rest are rehashed for a
+ * later revolution */
+static void Visit(s32 slot, OSTime now) {
+    IFQueue list;
+    IPTimer* timer;
+
+    list = Wheel[slot];
+    Wheel[slot].next = Wheel[slot].prev = NULL;
+
+    while (list.next != NULL) {
+        IFQueueDequeueHead(IPTimer*, &list, timer);
+        if (timer->expire <= now) {
+            timer->slot = IP_TIMER_FIRING;
+            IFQueueEnqueueTail(IPTimer*, &Firing, timer);
+        } else {
+            Insert(timer, GetTick(timer->expire));
+        }
+    }
+}
+
+static void TickCallback(OSAlarm* alarm, OSContext* context) {
+    BOOL enabled;
+    IPTimer* timer;
+    IPTimerHandler handler;
+    OSTime now;
+    OSTime last;
+    int n;
+
+    enabled = OSDisableInterrupts();
+    AlarmSet = FALSE;
+    Running = TRUE;
+    now = OSGetTime();
+    last = now / IP_TIMER_TICK;
+    for (n = 0; Tick <= last && n < IP_TIMER_SLOTS; n++) {
+        Tick++;
+        Visit((s32)((Tick - 1) & (IP_TIMER_SLOTS - 1)), now);
+    }
+
+    if (Tick <= last) {
+        /* Fell more than a revolution behind; every slot has been seen */
+        Tick = last + 1;
+    }
+
+    while (Firing.next != NULL) {
+        IFQueueDequeueHead(IPTimer*, &Firing, timer);
+        timer->slot = IP_TIMER_IDLE;
+        timer->expire = 0;
+        Count--;
+        handler = timer->handler;
+        handler(timer);
+    }
+
+    Running = FALSE;
+    if (0 < Count) {
+        Schedule(OSGetTime());
+    }
+    OSRestoreInterrupts(enabled);
+}
@@ -0,0 +1,113 @@
+#include <dolphin/private/ip.h>
+
+#include "Test.h"
+
+/*
+ * Out-of-order reassembly in the receive ring (MargeBlock, through
+ * IFRingInBlock and IFRingInEx). The ring is 16 bytes with head at 12, so
+ * offsets from 4 on wrap to the start of the buffer.
+ */
+
+#define SIZE 16
+#define HEAD 12
+#define MAXBLOCK 3
+
+static u8 Buf[SIZE];
+static IFBlock Table[MAXBLOCK];
+
+static s32 In(s32 used, s32 offset, const char* data) {
+    s32 adv;
+
+    adv = (s32)strlen(data);
+    IFRingInBlock(Buf, SIZE, Buf + HEAD, used, offset, (const u8*)data, &adv, Table, MAXBLOCK);
+    return adv;
+}
+
+static BOOL IsBlock(int i, s32 at, s32 len) {
+    return Table[i].ptr == Buf + at && Table[i].len == len;
+}
+
+static void Reset(void) {
+    memset(Buf, 0, sizeof(Buf));
+    memset(Table, 0, sizeof(Table));
+}
+
+static void TestInsert(void) {
+    Reset();
+    CHECK(In(0, 4, "AB") == 0);
+    CHECK(In(0, 10, "CD") == 0);
+    CHECK(In(0, 7, "E") == 0);
+
+    /* In arrival order */
+    CHECK(IsBlock(0, 0, 2));
+    CHECK(IsBlock(1, 6, 2));
+    CHECK(IsBlock(2, 3, 1));
+    CHECK(Buf[0] == 'A' && Buf[1] == 'B' && Buf[3] == 'E' && Buf[6] == 'C' && Buf[7] == 'D');
+}
+
+static void TestFull(void) {
+    IFBlock saved[MAXBLOCK];
+    s32 adv;
+
+    memmove(saved, Table, sizeof(Table));
+    CHECK(In(0, 13, "F") == -1);
+    CHECK(memcmp(saved, Table, sizeof(Table)) == 0);
+
+    /* IFRingInEx drops the segment the same way but reports 0 */
+    adv = 1;
+    IFRingInEx(Buf, SIZE, Buf + HEAD, 0, 13, (const u8*)"F", &adv, Table, MAXBLOCK);
+    CHECK(adv == 0);
+    CHECK(memcmp(saved, Table, sizeof(Table)) == 0);
+
+    /* Data inside a recorded block needs no new entry, but makes that
+     * block the most recent */
+    CHECK(In(0, 10, "C") == 0);
+    CHECK(IsBlock(0, 0, 2));
+    CHECK(IsBlock(1, 3, 1));
+    CHECK(IsBlock(2, 6, 2));
+}
+
+static void TestMerge(void) {
+    /* Fills the gap between the first two blocks and absorbs both */
+    CHECK(In(0, 6, "G") == 0);
+    CHECK(IsBlock(0, 6, 2));
+    CHECK(IsBlock(1, 0, 4));
+    CHECK(Table[2].ptr == NULL && Table[2].len == 0);
+
+    /* Data at tail takes the first block with it */
+    CHECK(In(0, 0, "wxyz") == 8);
+    CHECK(IsBlock(0, 6, 2));
+    CHECK(Table[1].ptr == NULL && Table[2].ptr == NULL);
+    CHECK(memcmp(Buf + HEAD, "wxyz", 4) == 0);
+}
+
+static void TestWrap(void) {
+    /* A block that straddles the end of the buffer */
+    Reset();
+    CHECK(In(0, 2, "abcd") == 0);
+    CHECK(IsBlock(0, 14, 4));
+    CHECK(Buf[14] == 'a' && Buf[15] == 'b' && Buf[0] == 'c' && Buf[1] == 'd');
+
+    /* A block past the wrap */
+    CHECK(In(0, 8, "e") == 0);
+    CHECK(IsBlock(0, 14, 4));
+    CHECK(IsBlock(1, 4, 1));
+
+    CHECK(In(0, 0, "yz") == 6);
+    CHECK(IsBlock(0, 4, 1));
+    CHECK(Table[1].ptr == NULL);
+
+    /* Tail itself past the wrap */
+    Reset();
+    CHECK(In(6, 0, "pq") == 2);
+    CHECK(Buf[2] == 'p' && Buf[3] == 'q');
+    CHECK(Table[0].ptr == NULL);
+}
+
+int main(void) {
+    TestInsert();
+    TestFull();
+    TestMerge();
+    TestWrap();
+    return TestReport("IFRing");
+}
@@ -0,0 +1,202 @@
+#include <dolphin/private/ip.h>
+
+#include <stdlib.h>
+
+#include "Test.h"
+
+/* Software segmentation of TCP datagrams larger than the MTU (IPOut) */
+
+#define MTU 140
+#define PAYLOAD 250
+#define SEG_MAX 8
+
+IPInterface __IFDefault;
+
+static IPInterface Iface;
+static const u8 Local[4] = { 192, 168, 0, 2 };
+static const u8 Peer[4] = { 10, 0, 0, 1 };
+
+static IFDatagram* Out[SEG_MAX];
+static int NumOut;
+static int NumAlloc;
+static int NumFree;
+static int AllocLeft;
+static s32 FailResult;
+static int Done;
+static s32 DoneResult;
+
+/* The rest of the stack, which IP.c calls into */
+void ICMPIn(IPInterface* interface, IPHeader* ip, u32 flag) {}
+void IGMPIn(IPInterface* interface, IPHeader* ip, u32 flag) {}
+void UDPIn(IPInterface* interface, IPHeader* ip, unsigned long flag) {}
+void TCPIn(IPInterface* interface, IPHeader* ip, u32 flag) {}
+u16 IGMPCheckSum(IGMP* igmp) { return 0; }
+u16 UDPCheckSum(IFVec* vec, s32 nVec) { return 0; }
+u16 TCPCheckSum(IFVec* vec, s32 nVec) { return 0x1234; }
+BOOL IPIsBroadcastAddr(IPInterface* interface, const u8* addr) { return FALSE; }
+s32 IPMulticastLookup(const u8* groupAddr, const u8* interface) { return 0; }
+s32 IPMulticastJoin(const u8* groupAddr, const u8* interface) { return 0; }
+s32 IPMulticastLeave(const u8* groupAddr, const u8* interface) { return 0; }
+s32 IPProcessSourceRoute(IPHeader* ip) { return 0; }
+IPHeader* IPReassemble(IPInterface* interface, IPHeader* frag, u32 flag) { return NULL; }
+BOOL TCPLookupTimeWait(const u8* src, u16 srcPort, const u8* dst, u16 dstPort) { return FALSE; }
+
+IPInterface* IPGetRoute(const u8* addr, u8* dst) {
+    if (dst != NULL) {
+        memmove(dst, addr, 4);
+    }
+    return &Iface;
+}
+
+static void* Alloc(IPInterface* interface, s32 size) {
+    if (AllocLeft == 0) {
+        return NULL;
+    }
+    AllocLeft--;
+    NumAlloc++;
+    return malloc(size);
+}
+
+static BOOL Free(IPInterface* interface, void* ptr, s32 size) {
+    NumFree++;
+    free(ptr);
+    return FALSE;
+}
+
+/* Holds segments until Complete unless FailResult is set, in which case the
+ * first segment fails at once */
+static void Output(IPInterface* interface, IFDatagram* datagram) {
+    if (NumOut < SEG_MAX) {
+        Out[NumOut] = datagram;
+    }
+    NumOut++;
+    if (FailResult < 0 && NumOut == 1) {
+        (*datagram->callback)(datagram->param, FailResult);
+    }
+}
+
+static void Complete(int from) {
+    int i;
+
+    for (i = from; i < NumOut && i < SEG_MAX; i++) {
+        (*Out[i]->callback)(Out[i]->param, 0);
+    }
+}
+
+static void OnDone(void* param, s32 result) {
+    Done++;
+    DoneResult = result;
+}
+
+static u8 Header[sizeof(IPHeader) + sizeof(TCPHeader)];
+static u8 Payload[PAYLOAD];
+static IFDatagram* Datagram;
+
+static void Reset(s32 payload) {
+    IPHeader* ip;
+    TCPHeader* tcp;
+
+    memset(&Iface, 0, sizeof(Iface));
+    Iface.mtu = MTU;
+    memmove(Iface.addr, Local, 4);
+    Iface.out = Output;
+    Iface.alloc = Alloc;
+    Iface.free = Free;
+
+    NumOut = NumAlloc = NumFree = Done = 0;
+    AllocLeft = SEG_MAX;
+    FailResult = 0;
+    DoneResult = 1;
+
+    ip = (IPHeader*)Header;
+    tcp = (TCPHeader*)(ip + 1);
+    memset(Header, 0, sizeof(Header));
+    ip->verlen = (4 << 4) | (sizeof(IPHeader) >> 2);
+    ip->len = (u16)(sizeof(Header) + payload);
+    ip->frag = IP_DONT_FRAG;
+    ip->ttl = 64;
+    ip->proto = IP_PROTO_TCP;
+    memmove(ip->src, Local, 4);
+    memmove(ip->dst, Peer, 4);
+    tcp->seq = 1000;
+    tcp->flag = (u16)((sizeof(TCPHeader) << 10) | TCP_FLAG_ACK | TCP_FLAG_PSH | TCP_FLAG_FIN);
+
+    if (Datagram == NULL) {
+        Datagram = (IFDatagram*)malloc(sizeof(IFDatagram) + sizeof(IFVec));
+    }
+    IFInitDatagram(Datagram, ETH_IP, 2);
+    Datagram->vec[0].data = Header;
+    Datagram->vec[0].len = sizeof(Header);
+    Datagram->vec[1].data = Payload;
+    Datagram->vec[1].len = payload;
+    Datagram->callback = OnDone;
+}
+
+static BOOL IsSeg(int i, s32 seq, s32 len, BOOL last) {
+    IPHeader* ip;
+    TCPHeader* tcp;
+    IFDatagram* seg;
+
+    seg = Out[i];
+    ip = (IPHeader*)seg->vec[0].data;
+    tcp = (TCPHeader*)(ip + 1);
+    return seg->nVec == 2 && seg->vec[1].data == Payload + (seq - 1000) && seg->vec[1].len == len && ip->len == sizeof(Header) + len &&
+           tcp->seq == seq && tcp->sum == 0x1234 && ((tcp->flag & (TCP_FLAG_FIN | TCP_FLAG_PSH)) != 0) == last;
+}
+
+static void TestSplit(void) {
+    Reset(PAYLOAD);
+    CHECK(IPOut(Datagram) == 0);
+    CHECK(NumOut == 3 && Out[0] != Datagram);
+    CHECK(IsSeg(0, 1000, 100, FALSE));
+    CHECK(IsSeg(1, 1100, 100, FALSE));
+    CHECK(IsSeg(2, 1200, 50, TRUE));
+
+    /* Completes with the last segment, each buffer freed as it goes */
+    Complete(0);
+    CHECK(Done == 1 && DoneResult == 0);
+    CHECK(NumAlloc == 3 && NumFree == 3);
+}
+
+static void TestFits(void) {
+    Reset(MTU - sizeof(Header));
+    CHECK(IPOut(Datagram) == 0);
+    CHECK(NumOut == 1 && Out[0] == Datagram && NumAlloc == 0);
+}
+
+static void TestFail(void) {
+    /* The first segment fails at once: the rest are never sent */
+    Reset(PAYLOAD);
+    FailResult = -5;
+    CHECK(IPOut(Datagram) == 0);
+    CHECK(NumOut == 1);
+    CHECK(Done == 1 && DoneResult == -5);
+    CHECK(NumAlloc == 3 && NumFree == 3);
+}
+
+static void TestNoBuffer(void) {
+    int i;
+
+    /* Every state is given back, so this can run more often than there
+     * are states */
+    for (i = 0; i < IP_SEG_NUM + 1; i++) {
+        Reset(PAYLOAD);
+        AllocLeft = 2;
+        CHECK(IPOut(Datagram) == -42);
+        CHECK(NumOut == 0 && Done == 0);
+        CHECK(NumAlloc == 2 && NumFree == 2);
+    }
+
+    Reset(PAYLOAD);
+    CHECK(IPOut(Datagram) == 0);
+    Complete(0);
+    CHECK(Done == 1 && NumFree == 3);
+}
+
+int main(void) {
+    TestSplit();
+    TestFits();
+    TestFail();
+    TestNoBuffer();
+    return TestReport("IPSeg");
+}
@@ -0,0 +1,77 @@
+#include <dolphin/private/ip.h>
+
+#include "Test.h"
+
+/* The delayed-ACK policy (TCPAckNow) */
+
+#define MS(n) OSMillisecondsToTicks((OSTime)(n))
+
+static TCPInfo Tcp;
+
+static void Reset(void) {
+    memset(&Tcp, 0, sizeof(Tcp));
+    Tcp.mss = 100;
+    Tcp.recvBuff = 1000;
+    TCPSackInitRecv(&Tcp);
+    TCPAckInit(&Tcp);
+}
+
+/* Feeds n segments of len bytes 1ms apart and returns how many were to be
+ * ACKed at once, sending each of those ACKs */
+static int Feed(int n, s32 len) {
+    int now;
+
+    now = 0;
+    while (0 < n--) {
+        TestAdvance(MS(1));
+        if (TCPAckNow(&Tcp, len)) {
+            TCPAckSent(&Tcp);
+            now++;
+        }
+    }
+    return now;
+}
+
+static void TestQuickAck(void) {
+    /* recvBuff / (2 * mss) segments ACKed at once, then every second one */
+    Reset();
+    CHECK(Tcp.ackQuick == 5);
+    CHECK(Feed(5, 100) == 5);
+    CHECK(Feed(6, 100) == 3);
+
+    /* Short segments wait for dackAlarm */
+    CHECK(Feed(4, 10) == 0);
+
+    /* After an idle period quick-ack mode starts over */
+    TestAdvance(TCP_ACK_IDLE);
+    CHECK(Feed(5, 10) == 5);
+    CHECK(Feed(1, 10) == 0);
+}
+
+static void TestImmediate(void) {
+    Reset();
+    CHECK(Feed(5, 100) == 5);
+
+    /* A hole in the receive ring */
+    Tcp.asb[0].ptr = (u8*)&Tcp;
+    Tcp.asb[0].len = 10;
+    CHECK(Feed(3, 10) == 3);
+    TCPSackInitRecv(&Tcp);
+
+    /* Less than two segments of window left */
+    Tcp.recvUser = Tcp.recvBuff - 150;
+    CHECK(Feed(3, 10) == 3);
+    Tcp.recvUser = 0;
+    CHECK(Feed(1, 10) == 0);
+
+    /* Delayed ACKs turned off */
+    Tcp.ackEvery = 0;
+    CHECK(Feed(3, 10) == 3);
+}
+
+int main(void) {
+    TestSetTime(OSSecondsToTicks((OSTime)1));
+    TestQuickAck();
+    TestImmediate();
+    return TestReport("IPTcpAck");
+}
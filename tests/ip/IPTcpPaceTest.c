@@ -0,0 +1,98 @@
+#include <dolphin/private/ip.h>
+
+#include "Test.h"
+
+/* Pacing (TCPPaceCheck) on the timer wheel, driven by the fake clock in
+ * OSStub.c. The clock starts on a wheel tick. */
+
+#define MS(n) OSMillisecondsToTicks((OSTime)(n))
+
+static TCPInfo A;
+static TCPInfo B;
+static TCPInfo* Sent[4];
+static int NumSent;
+
+static void Output(TCPInfo* tcp) {
+    if (NumSent < 4) {
+        Sent[NumSent] = tcp;
+    }
+    NumSent++;
+}
+
+static void Reset(void) {
+    TCPPaceInit();
+    TCPPaceSetOutput(Output);
+    memset(&A, 0, sizeof(A));
+    memset(&B, 0, sizeof(B));
+    NumSent = 0;
+}
+
+static void TestDue(void) {
+    Reset();
+
+    /* Not paced, or due within the slack */
+    CHECK(TCPPaceCheck(&A));
+    A.paceNext = OSGetTime() + OSMicrosecondsToTicks(100);
+    CHECK(TCPPaceCheck(&A));
+    CHECK(!A.paceQueued && TestPendingAlarms() == 0);
+}
+
+static void TestQueue(void) {
+    Reset();
+    A.paceNext = OSGetTime() + MS(5);
+    B.paceNext = OSGetTime() + MS(2);
+
+    CHECK(!TCPPaceCheck(&A));
+    CHECK(!TCPPaceCheck(&B));
+    CHECK(!TCPPaceCheck(&A));
+    CHECK(A.paceQueued && B.paceQueued);
+    CHECK(TestPendingAlarms() == 1);
+
+    /* Resumed on the next wheel tick in paceNext order, each once */
+    TestAdvance(IP_TIMER_TICK - 1);
+    CHECK(NumSent == 0);
+    TestAdvance(1);
+    CHECK(NumSent == 2 && Sent[0] == &B && Sent[1] == &A);
+    CHECK(!A.paceQueued && !B.paceQueued);
+    CHECK(TestPendingAlarms() == 0);
+}
+
+static void TestCancel(void) {
+    Reset();
+    A.paceNext = OSGetTime() + MS(2);
+    B.paceNext = OSGetTime() + MS(4);
+    CHECK(!TCPPaceCheck(&A));
+    CHECK(!TCPPaceCheck(&B));
+
+    TCPPaceCancel(&A);
+    CHECK(!A.paceQueued);
+    TestAdvance(IP_TIMER_TICK);
+    CHECK(NumSent == 1 && Sent[0] == &B);
+
+    TCPPaceCancel(&B);
+    CHECK(TestPendingAlarms() == 0);
+}
+
+static void TestSent(void) {
+    OSTime now;
+
+    /* Capped at paceMaxRate: 100 bytes at 1000 bytes/s take 100ms */
+    Reset();
+    A.paceMaxRate = 1000;
+    now = OSGetTime();
+    TCPPaceSent(&A, 100);
+    CHECK(A.paceNext == now + MS(100));
+    CHECK(!TCPPaceCheck(&A));
+    TestAdvance(MS(100));
+    CHECK(NumSent == 1 && Sent[0] == &A);
+    CHECK(TCPPaceCheck(&A));
+}
+
+int main(void) {
+    TestSetTime(OSSecondsToTicks((OSTime)1));
+    TestDue();
+    TestQueue();
+    TestCancel();
+    TestSent();
+    return TestReport("IPTcpPace");
+}
@@ -0,0 +1,199 @@
+#include <dolphin/private/ip.h>
+
+#include "Test.h"
+
+/* Header prediction (TCPPredictIn) on an established connection */
+
+#define UNA 1000
+#define RCV 5000
+#define WIN 8000
+
+typedef struct Segment {
+    TCPHeader th;
+    u8 opt[TCP_OPT_TS_LEN];
+} Segment;
+
+static TCPInfo Tcp;
+static u8 SendBuf[256];
+static u8 RecvBuf[256];
+static u8 UserBuf[16];
+static s32 Acked;
+
+static void OnAck(TCPInfo* tcp, s32 acked) {
+    Acked += acked;
+}
+
+s32 __SOClampWindow(TCPInfo* tcp, s32 win) {
+    return win;
+}
+
+static const TCPCongestionOps TestCC = { "test", NULL, OnAck, NULL, NULL, NULL };
+
+static void Reset(void) {
+    TCPSackInit();
+    TCPRackInit();
+    memset(&Tcp, 0, sizeof(Tcp));
+    memset(RecvBuf, 0, sizeof(RecvBuf));
+    memset(UserBuf, 0, sizeof(UserBuf));
+    Tcp.state = TCP_STATE_ESTABLISHED;
+    Tcp.cc = &TestCC;
+    Tcp.mss = 100;
+    Tcp.sendUna = UNA;
+    Tcp.sendNext = Tcp.sendMax = UNA + 200;
+    Tcp.sendWin = WIN;
+    Tcp.cWin = 2 * WIN;
+    Tcp.sendData = Tcp.sendPtr = SendBuf;
+    Tcp.sendBuff = sizeof(SendBuf);
+    Tcp.sendLen = 200;
+    Tcp.recvNext = RCV;
+    Tcp.recvData = Tcp.recvPtr = RecvBuf;
+    Tcp.recvBuff = sizeof(RecvBuf);
+    TCPSackInitRecv(&Tcp);
+    TCPOptInit(&Tcp);
+    Tcp.optFlag = 0;
+    Tcp.lastAckSent = RCV;
+    TCPAckInit(&Tcp);
+    Acked = 0;
+}
+
+/* Builds a segment, with the timestamp option if tsVal is not 0 */
+static const TCPHeader* Build(Segment* seg, u16 flag, s32 seq, s32 ack, u32 tsVal) {
+    memset(seg, 0, sizeof(Segment));
+    seg->th.seq = seq;
+    seg->th.ack = ack;
+    seg->th.win = WIN;
+    seg->th.flag = (u16)((5 << 12) | flag);
+    if (tsVal != 0) {
+        seg->th.flag += 3 << 12;
+        seg->opt[0] = TCP_OPT_NOP;
+        seg->opt[1] = TCP_OPT_NOP;
+        seg->opt[2] = TCP_OPT_TS;
+        seg->opt[3] = 10;
+        memmove(&seg->opt[4], &tsVal, 4);
+    }
+    return &seg->th;
+}
+
+static void TestPureAck(void) {
+    Segment seg;
+    TCPOptions opt;
+
+    Reset();
+    CHECK(TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV, UNA + 100, 0), NULL, 0, &opt) == TCP_PREDICT_ACKED);
+    CHECK(Tcp.sendUna == UNA + 100);
+    CHECK(Tcp.sendLen == 100);
+    CHECK(Tcp.sendPtr == SendBuf + 100);
+    CHECK(Acked == 100);
+}
+
+static void TestSlowPath(void) {
+    Segment seg;
+    TCPOptions opt;
+
+    Reset();
+    CHECK(TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK | TCP_FLAG_FIN, RCV, UNA + 100, 0), NULL, 0, &opt) == TCP_PREDICT_NONE);
+    CHECK(TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV + 1, UNA + 100, 0), NULL, 0, &opt) == TCP_PREDICT_NONE);
+
+    /* Duplicate ACK, and one for data never sent */
+    CHECK(TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV, UNA, 0), NULL, 0, &opt) == TCP_PREDICT_NONE);
+    CHECK(TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV, UNA + 300, 0), NULL, 0, &opt) == TCP_PREDICT_NONE);
+
+    /* Window update */
+    Build(&seg, TCP_FLAG_ACK, RCV, UNA + 100, 0);
+    seg.th.win = WIN / 2;
+    CHECK(TCPPredictIn(&Tcp, &seg.th, NULL, 0, &opt) == TCP_PREDICT_NONE);
+
+    /* In recovery */
+    Tcp.dupAcks = 3;
+    CHECK(TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV, UNA + 100, 0), NULL, 0, &opt) == TCP_PREDICT_NONE);
+
+    CHECK(Tcp.sendUna == UNA && Tcp.sendLen == 200 && Acked == 0);
+}
+
+static void TestData(void) {
+    Segment seg;
+    TCPOptions opt;
+    s32 result;
+
+    Reset();
+    result = TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV, UNA, 0), (const u8*)"hello", 5, &opt);
+    CHECK((result & ~TCP_PREDICT_ACK_NOW) == TCP_PREDICT_DATA);
+    CHECK(Tcp.recvNext == RCV + 5);
+    CHECK(Tcp.recvUser == 5);
+    CHECK(memcmp(RecvBuf, "hello", 5) == 0);
+
+    /* Out of order data waiting in TCPInfo.asb forces the slow path */
+    Tcp.asb[0].ptr = RecvBuf + 100;
+    Tcp.asb[0].len = 10;
+    CHECK(TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV + 5, UNA, 0), (const u8*)"world", 5, &opt) == TCP_PREDICT_NONE);
+    CHECK(Tcp.recvNext == RCV + 5);
+
+    /* No room in the ring */
+    Reset();
+    Tcp.recvUser = sizeof(RecvBuf) - 2;
+    CHECK(TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV, UNA, 0), (const u8*)"hello", 5, &opt) == TCP_PREDICT_NONE);
+}
+
+static void TestTimestamp(void) {
+    Segment seg;
+    TCPOptions opt;
+
+    Reset();
+    Tcp.optFlag = TCP_OPT_FLAG_TS;
+    Tcp.tsRecent = 100;
+
+    /* A bare header when timestamps are in use */
+    CHECK(TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV, UNA + 100, 0), NULL, 0, &opt) == TCP_PREDICT_NONE);
+
+    CHECK(TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV, UNA + 100, 150), NULL, 0, &opt) == TCP_PREDICT_ACKED);
+    CHECK(opt.flag == TCP_OPT_FLAG_TS && opt.tsVal == 150);
+    CHECK(Tcp.tsRecent == 150);
+
+    /* Older than tsRecent: PAWS is left to the slow path */
+    CHECK(TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV, UNA + 150, 120), NULL, 0, &opt) == TCP_PREDICT_NONE);
+    CHECK(Tcp.tsRecent == 150 && Tcp.sendUna == UNA + 100);
+}
+
+static void TestPlace(void) {
+    Segment seg;
+    TCPOptions opt;
+    s32 result;
+
+    /* With a receive posted and the ring empty, data bypasses the ring */
+    Reset();
+    Tcp.userData = UserBuf;
+    Tcp.userBuff = sizeof(UserBuf);
+    result = TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV, UNA, 0), (const u8*)"hello", 5, &opt);
+    CHECK((result & ~TCP_PREDICT_ACK_NOW) == (TCP_PREDICT_DATA | TCP_PREDICT_PLACED));
+    CHECK(Tcp.userLen == 5 && memcmp(UserBuf, "hello", 5) == 0);
+    CHECK(Tcp.recvUser == 0 && Tcp.recvNext == RCV + 5);
+
+    /* What does not fit goes to the ring */
+    Tcp.userLen = sizeof(UserBuf) - 2;
+    result = TCPPredictIn(&Tcp, Build(&seg, TCP_FLAG_ACK, RCV + 5, UNA, 0), (const u8*)"abcdef", 6, &opt);
+    CHECK((result & ~TCP_PREDICT_ACK_NOW) == (TCP_PREDICT_DATA | TCP_PREDICT_PLACED));
+    CHECK(Tcp.userLen == sizeof(UserBuf) && memcmp(UserBuf + sizeof(UserBuf) - 2, "ab", 2) == 0);
+    CHECK(Tcp.recvUser == 4 && memcmp(RecvBuf, "cdef", 4) == 0);
+    CHECK(Tcp.recvNext == RCV + 11);
+
+    /* Nothing may overtake data already in the ring */
+    Tcp.userLen = 0;
+    CHECK(TCPPredictPlace(&Tcp, (const u8*)"xyz", 3) == 0);
+    CHECK(Tcp.userLen == 0);
+
+    Tcp.recvUser = 0;
+    CHECK(TCPPredictPlace(&Tcp, (const u8*)"xyz", 3) == 3);
+    CHECK(Tcp.userLen == 3 && memcmp(UserBuf, "xyz", 3) == 0);
+
+    Tcp.userData = NULL;
+    CHECK(TCPPredictPlace(&Tcp, (const u8*)"xyz", 3) == 0);
+}
+
+int main(void) {
+    TestPureAck();
+    TestSlowPath();
+    TestData();
+    TestTimestamp();
+    TestPlace();
+    return TestReport("IPTcpPredict");
+}
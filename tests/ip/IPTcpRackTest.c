@@ -0,0 +1,108 @@
+#include <dolphin/private/ip.h>
+
+#include "Test.h"
+
+/* RACK-TLP timers calling the output routine set by TCPRackSetOutput */
+
+#define MS(n) OSMillisecondsToTicks((OSTime)(n))
+
+static TCPInfo Tcp;
+static int Probes;
+static int Rxmits;
+
+static void Output(TCPInfo* tcp, BOOL probe) {
+    if (probe) {
+        Probes++;
+    } else {
+        Rxmits++;
+    }
+}
+
+static void Reset(void) {
+    TCPRackInit();
+    TCPSackInit();
+    TCPRackSetOutput(Output);
+    memset(&Tcp, 0, sizeof(Tcp));
+    IPTimerCreate(&Tcp.rackAlarm);
+    Tcp.mss = 100;
+    Tcp.srtt = MS(50);
+    Tcp.rttMin = MS(80);
+    Tcp.sendUna = Tcp.sendMax = 1000;
+    Probes = Rxmits = 0;
+}
+
+static void Send(s32 len) {
+    TCPRackSent(&Tcp, Tcp.sendMax, len);
+    Tcp.sendMax += len;
+}
+
+static void TestProbe(void) {
+    OSTime pto;
+
+    /* A single segment flight: two srtt plus the delayed ACK allowance */
+    Reset();
+    Send(100);
+    CHECK(Tcp.rackTimer == TCP_RACK_TIMER_TLP);
+    pto = 2 * Tcp.srtt + TCP_RACK_DACK_MAX;
+    TestAdvance(pto - MS(10));
+    CHECK(Probes == 0);
+    TestAdvance(MS(20));
+    CHECK(Probes == 1 && Rxmits == 0);
+    CHECK(Tcp.tlpPending && Tcp.tlpHighSeq == 1100);
+
+    /* One probe per flight */
+    TestAdvance(MS(1000));
+    CHECK(Probes == 1);
+
+    /* The ACK for the probe ends the flight and the timer */
+    Tcp.sendUna = 1100;
+    CHECK(TCPRackAck(&Tcp) == 0);
+    CHECK(!Tcp.tlpPending && Tcp.rackTimer == TCP_RACK_TIMER_NONE);
+    TCPRackClear(&Tcp);
+}
+
+static void TestReorder(void) {
+    s32 start;
+    s32 end;
+
+    Reset();
+    Send(100);
+    TestAdvance(MS(10));
+    Send(100);
+    TestAdvance(MS(50));
+
+    /* The second segment is SACKed 50ms after it went out. The first is
+     * lost once rackRtt plus a reordering window of rttMin / 4 have passed
+     * since it was sent. */
+    TCPSackUpdate(&Tcp, 1100, 1200);
+    CHECK(TCPRackAck(&Tcp) == 0);
+    CHECK(Tcp.rackTimer == TCP_RACK_TIMER_REO);
+    TestAdvance(MS(20));
+    CHECK(Rxmits == 1 && Probes == 0);
+    CHECK(Tcp.rackLost == 100);
+    CHECK(TCPRackNextLost(&Tcp, &start, &end) && start == 1000 && end == 1100);
+
+    /* The retransmission clears the mark */
+    TCPRackSent(&Tcp, 1000, 100);
+    CHECK(Tcp.rackLost == 0);
+    TCPRackClear(&Tcp);
+    TCPSackClear(&Tcp);
+}
+
+static void TestNoOutput(void) {
+    Reset();
+    TCPRackSetOutput(NULL);
+    Send(100);
+    TestAdvance(MS(1000));
+    CHECK(Tcp.tlpPending && Probes == 0);
+    TCPRackClear(&Tcp);
+    CHECK(TestPendingAlarms() == 0);
+}
+
+int main(void) {
+    TestSetTime(OSSecondsToTicks((OSTime)1));
+    TestProbe();
+    TestReorder();
+    TestNoOutput();
+    return TestReport("IPTcpRack");
+}
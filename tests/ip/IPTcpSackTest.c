@@ -0,0 +1,156 @@
+#include <dolphin/private/ip.h>
+
+#include "Test.h"
+
+/* The sender's SACK scoreboard (TCPSackUpdate) and the receiver's SACK
+ * option (TCPSackBuildOption) */
+
+static TCPInfo Tcp;
+
+static void Reset(s32 una, s32 max) {
+    TCPSackInit();
+    memset(&Tcp, 0, sizeof(Tcp));
+    Tcp.sendUna = una;
+    Tcp.sendMax = max;
+    Tcp.mss = 100;
+}
+
+/* Checks the scoreboard against n start/end pairs */
+static BOOL IsBoard(int n, const s32* blocks) {
+    TCPSackBlock* block;
+    s32 bytes;
+    int i;
+
+    bytes = 0;
+    block = (TCPSackBlock*)Tcp.sackList.next;
+    for (i = 0; i < n; i++, block = (TCPSackBlock*)block->link.next) {
+        if (block == NULL || block->start != blocks[2 * i] || block->end != blocks[2 * i + 1]) {
+            return FALSE;
+        }
+        bytes += block->end - block->start;
+    }
+    return block == NULL && Tcp.sackCount == n && Tcp.sackBytes == bytes;
+}
+
+static void TestInsert(void) {
+    static const s32 board[] = { 1500, 1600, 2000, 2100, 3000, 3100 };
+
+    Reset(1000, 10000);
+    TCPSackUpdate(&Tcp, 2000, 2100);
+    TCPSackUpdate(&Tcp, 3000, 3100);
+    TCPSackUpdate(&Tcp, 1500, 1600);
+    CHECK(IsBoard(3, board));
+}
+
+static void TestMerge(void) {
+    static const s32 overlap[] = { 1500, 1600, 2000, 2200, 3000, 3100 };
+    static const s32 adjacent[] = { 1500, 1600, 1900, 2300, 3000, 3100 };
+    static const s32 inside[] = { 1500, 1600, 1900, 2300, 3000, 3100 };
+
+    TCPSackUpdate(&Tcp, 2050, 2200);
+    CHECK(IsBoard(3, overlap));
+
+    TCPSackUpdate(&Tcp, 2200, 2300);
+    TCPSackUpdate(&Tcp, 1900, 2000);
+    CHECK(IsBoard(3, adjacent));
+
+    TCPSackUpdate(&Tcp, 2100, 2150);
+    CHECK(IsBoard(3, inside));
+}
+
+static void TestAbsorb(void) {
+    static const s32 one[] = { 1400, 3100 };
+    static const s32 two[] = { 1000, 1100, 1400, 3100 };
+    static const s32 top[] = { 1000, 1100, 1400, 3100, 4000, 4100, 4200, 4300 };
+    static const s32 all[] = { 1000, 1100, 1400, 4400 };
+    s32 start;
+    s32 end;
+
+    /* Reaches down over every block below it */
+    TCPSackUpdate(&Tcp, 1400, 3050);
+    CHECK(IsBoard(1, one));
+    CHECK(TCPSackIsSacked(&Tcp, 2500));
+
+    /* Clipped to sendUna */
+    TCPSackUpdate(&Tcp, 900, 1100);
+    CHECK(IsBoard(2, two));
+
+    /* Below sendUna or beyond sendMax: ignored */
+    TCPSackUpdate(&Tcp, 500, 900);
+    TCPSackUpdate(&Tcp, 9000, 10001);
+    CHECK(IsBoard(2, two));
+
+    TCPSackUpdate(&Tcp, 4200, 4300);
+    TCPSackUpdate(&Tcp, 4000, 4100);
+    CHECK(IsBoard(4, top));
+
+    /* Covers the top block and bridges the two below it */
+    TCPSackUpdate(&Tcp, 3100, 4400);
+    CHECK(IsBoard(2, all));
+    CHECK(TCPSackNextHole(&Tcp, 1000, &start, &end) && start == 1100 && end == 1400);
+    CHECK(!TCPSackNextHole(&Tcp, 1400, &start, &end));
+
+    TCPSackClear(&Tcp);
+    CHECK(IsBoard(0, NULL));
+}
+
+static void TestWrap(void) {
+    static const s32 board[] = { -100, 100 };
+
+    /* Sequence numbers wrap between the blocks */
+    Reset(-200, 1000);
+    TCPSackUpdate(&Tcp, 50, 100);
+    TCPSackUpdate(&Tcp, -100, -50);
+    CHECK(Tcp.sackCount == 2 && ((TCPSackBlock*)Tcp.sackList.next)->start == -100);
+
+    TCPSackUpdate(&Tcp, -60, 60);
+    CHECK(IsBoard(1, board));
+}
+
+static BOOL IsOptBlock(const u8* opt, int i, s32 start, s32 end) {
+    s32 seq[2];
+
+    memmove(seq, opt + 4 + 8 * i, 8);
+    return seq[0] == start && seq[1] == end;
+}
+
+static void TestOption(void) {
+    static u8 ring[64];
+    static const u8 data[16];
+    u8 opt[40];
+
+    memset(&Tcp, 0, sizeof(Tcp));
+    Tcp.recvData = Tcp.recvPtr = ring;
+    Tcp.recvBuff = sizeof(ring);
+    Tcp.recvNext = 1000;
+    TCPSackInitRecv(&Tcp);
+    CHECK(TCPSackBuildOption(&Tcp, opt, sizeof(opt)) == 0);
+
+    CHECK(TCPSackQueue(&Tcp, 1040, data, 10) == 0);
+    CHECK(TCPSackQueue(&Tcp, 1020, data, 10) == 0);
+    /* Extends the first block, which is now the most recent */
+    CHECK(TCPSackQueue(&Tcp, 1045, data, 10) == 0);
+
+    CHECK(TCPSackBuildOption(&Tcp, opt, sizeof(opt)) == 20);
+    CHECK(opt[2] == TCP_OPT_SACK && opt[3] == 18);
+    CHECK(IsOptBlock(opt, 0, 1040, 1055));
+    CHECK(IsOptBlock(opt, 1, 1020, 1030));
+
+    /* Only room for the most recent block */
+    CHECK(TCPSackBuildOption(&Tcp, opt, 12) == 12);
+    CHECK(IsOptBlock(opt, 0, 1040, 1055));
+
+    /* Filling the hole hands over the block behind it */
+    CHECK(TCPSackQueue(&Tcp, 1000, data, 20) == 30);
+    CHECK(TCPSackBuildOption(&Tcp, opt, sizeof(opt)) == 12);
+    CHECK(IsOptBlock(opt, 0, 1040, 1055));
+}
+
+int main(void) {
+    TestInsert();
+    TestMerge();
+    TestAbsorb();
+    TestWrap();
+    TestOption();
+    return TestReport("IPTcpSack");
+}
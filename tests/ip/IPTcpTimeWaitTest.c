@@ -0,0 +1,86 @@
+#include <dolphin/private/ip.h>
+
+#include "Test.h"
+
+/* The hashed TIME_WAIT table expired from the timer wheel */
+
+#define MS(n) OSMillisecondsToTicks((OSTime)(n))
+
+/* Room for the hash chains and 8 records */
+static u32 Buf[(16 * sizeof(u16) + 8 * sizeof(TCPTimeWaitEntry)) / sizeof(u32)];
+
+static const u8 Local[4] = { 192, 168, 0, 2 };
+static const u8 Peer[4] = { 10, 0, 0, 1 };
+
+static BOOL Enter(u16 port) {
+    return TCPEnterTimeWait(Local, port, Peer, 80);
+}
+
+static BOOL Lookup(u16 port) {
+    return TCPLookupTimeWait(Local, port, Peer, 80);
+}
+
+static void TestLookup(void) {
+    TCPSetTimeWaitTable(NULL, 0);
+    CHECK(!Enter(1000));
+
+    TCPSetTimeWaitTable(Buf, sizeof(Buf));
+    CHECK(Enter(1000));
+    CHECK(Enter(1001));
+    CHECK(Lookup(1000) && Lookup(1001));
+    CHECK(!Lookup(1002));
+    CHECK(!TCPLookupTimeWait(Local, 1000, Peer, 81));
+    CHECK(TCPGetTimeWaitCount() == 2);
+
+    CHECK(TCPRemoveTimeWait(Local, 1000, Peer, 80));
+    CHECK(!Lookup(1000) && Lookup(1001));
+    CHECK(!TCPRemoveTimeWait(Local, 1000, Peer, 80));
+}
+
+static void TestExpire(void) {
+    TCPSetTimeWaitTable(Buf, sizeof(Buf));
+    CHECK(Enter(2000));
+    TestAdvance(TCP_TIMEWAIT_TIME / 2);
+    CHECK(Enter(2001));
+
+    TestAdvance(TCP_TIMEWAIT_TIME / 2 + MS(20));
+    CHECK(!Lookup(2000) && Lookup(2001));
+    CHECK(TCPGetTimeWaitCount() == 1);
+
+    TestAdvance(TCP_TIMEWAIT_TIME / 2);
+    CHECK(!Lookup(2001));
+    CHECK(TCPGetTimeWaitCount() == 0);
+    CHECK(TestPendingAlarms() == 0);
+}
+
+static void TestFull(void) {
+    int i;
+
+    /* The oldest record makes way when the ring is full */
+    TCPSetTimeWaitTable(Buf, sizeof(Buf));
+    for (i = 0; i < 9; i++) {
+        CHECK(Enter((u16)(3000 + i)));
+    }
+    CHECK(!Lookup(3000));
+    for (i = 1; i < 9; i++) {
+        CHECK(Lookup((u16)(3000 + i)));
+    }
+
+    /* Re-entering a tuple keeps one record for it */
+    CHECK(Enter(3008));
+    CHECK(Lookup(3008));
+    CHECK(TCPRemoveTimeWait(Local, 3008, Peer, 80));
+    CHECK(!Lookup(3008));
+
+    TCPSetTimeWaitTable(NULL, 0);
+    CHECK(!Lookup(3001));
+    CHECK(TestPendingAlarms() == 0);
+}
+
+int main(void) {
+    TestSetTime(OSSecondsToTicks((OSTime)1));
+    TestLookup();
+    TestExpire();
+    TestFull();
+    return TestReport("IPTcpTimeWait");
+}
@@ -0,0 +1,121 @@
+#include <dolphin/private/ip.h>
+
+#include "Test.h"
+
+/* The timer wheel (IPTimer.c) driven by the fake clock in OSStub.c */
+
+#define MS(n) OSMillisecondsToTicks((OSTime)(n))
+
+static IPTimer A;
+static IPTimer B;
+static int FiredA;
+static int FiredB;
+static OSTime FireTimeA;
+static BOOL CancelB;
+static BOOL RearmA;
+
+static void HandlerA(IPTimer* timer) {
+    FiredA++;
+    FireTimeA = OSGetTime();
+    if (CancelB) {
+        IPTimerCancel(&B);
+    }
+    if (RearmA) {
+        RearmA = FALSE;
+        IPTimerSet(timer, MS(100), HandlerA);
+    }
+}
+
+static void HandlerB(IPTimer* timer) {
+    FiredB++;
+}
+
+static void Reset(void) {
+    IPTimerCreate(&A);
+    IPTimerCreate(&B);
+    FiredA = FiredB = 0;
+    FireTimeA = 0;
+    CancelB = RearmA = FALSE;
+}
+
+static void TestRearmLater(void) {
+    OSTime expire;
+
+    Reset();
+    IPTimerSet(&A, MS(50), HandlerA);
+    TestAdvance(MS(30));
+
+    /* Pushed out before it was due: the old slot must not fire it */
+    IPTimerSet(&A, MS(50), HandlerA);
+    expire = A.expire;
+    TestAdvance(MS(40));
+    CHECK(FiredA == 0);
+    CHECK(IPTimerIsArmed(&A));
+
+    TestAdvance(MS(30));
+    CHECK(FiredA == 1);
+    CHECK(expire <= FireTimeA && FireTimeA <= expire + IP_TIMER_TICK);
+    CHECK(!IPTimerIsArmed(&A));
+    CHECK(TestPendingAlarms() == 0);
+}
+
+static void TestCancelWhileFiring(void) {
+    Reset();
+    IPTimerSet(&A, MS(20), HandlerA);
+    IPTimerSet(&B, MS(20), HandlerB);
+    CancelB = RearmA = TRUE;
+
+    /* A runs first, cancels B, which is already due, and re-arms itself */
+    TestAdvance(MS(40));
+    CHECK(FiredA == 1);
+    CHECK(FiredB == 0);
+    CHECK(!IPTimerIsArmed(&B));
+    CHECK(IPTimerIsArmed(&A));
+
+    TestAdvance(MS(110));
+    CHECK(FiredA == 2);
+    CHECK(FiredB == 0);
+    CHECK(TestPendingAlarms() == 0);
+
+    /* Cancelling an idle timer is harmless */
+    IPTimerCancel(&B);
+    CHECK(TestPendingAlarms() == 0);
+}
+
+static void TestWrap(void) {
+    OSTime expire;
+    int fires;
+
+    Reset();
+    fires = TestAlarmFires();
+
+    /* Two revolutions and a bit: the slot comes round twice early */
+    IPTimerSet(&A, MS(2 * IP_TIMER_SLOTS * 10 + 255), HandlerA);
+    expire = A.expire;
+    TestAdvance(MS(2 * IP_TIMER_SLOTS * 10 + 200));
+    CHECK(FiredA == 0);
+
+    TestAdvance(MS(100));
+    CHECK(FiredA == 1);
+    CHECK(expire <= FireTimeA && FireTimeA <= expire + IP_TIMER_TICK);
+
+    /* Empty ticks are skipped; only early visits of the slot wake it */
+    CHECK(TestAlarmFires() - fires <= 4);
+    CHECK(TestPendingAlarms() == 0);
+
+    /* A short timer set after a long idle period fires on time */
+    TestAdvance(MS(12345));
+    IPTimerSet(&B, MS(30), HandlerB);
+    TestAdvance(MS(29));
+    CHECK(FiredB == 0);
+    TestAdvance(MS(11));
+    CHECK(FiredB == 1);
+}
+
+int main(void) {
+    TestSetTime(OSSecondsToTicks((OSTime)1));
+    TestRearmLater();
+    TestCancelWhileFiring();
+    TestWrap();
+    return TestReport("IPTimer");
+}
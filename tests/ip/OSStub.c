@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Test.h"
+
+/*
+ * Just enough of the OS for the IP sources under test. There is one thread
+ * and no real interrupts: OSDisableInterrupts only tracks the nesting, and
+ * alarms fire from TestAdvance in the order they fall due, with the clock
+ * set to each alarm's fire time while its handler runs.
+ */
+
+static OSTime Now;
+static OSAlarm* Alarms; // sorted by fire
+static BOOL Enabled = TRUE;
+static int Fires;
+static int Checks;
+static int Failures;
+
+void TestCheck(BOOL ok, const char* file, int line, const char* cond) {
+    Checks++;
+    if (!ok) {
+        Failures++;
+        printf("%s:%d: check failed: %s\n", file, line, cond);
+    }
+}
+
+int TestReport(const char* name) {
+    printf("%s: %d checks, %d failed\n", name, Checks, Failures);
+    return (Failures == 0) ? 0 : 1;
+}
+
+void __TestAssert(const char* file, int line, const char* cond) {
+    printf("%s: assertion %d failed: %s\n", file, line, cond);
+    exit(1);
+}
+
+void OSReport(const char* msg, ...) {
+}
+
+OSTime OSGetTime(void) {
+    return Now;
+}
+
+OSTick OSGetTick(void) {
+    return (OSTick)Now;
+}
+
+BOOL OSDisableInterrupts(void) {
+    BOOL prev;
+
+    prev = Enabled;
+    Enabled = FALSE;
+    return prev;
+}
+
+BOOL OSRestoreInterrupts(BOOL level) {
+    BOOL prev;
+
+    prev = Enabled;
+    Enabled = level;
+    return prev;
+}
+
+void OSCreateAlarm(OSAlarm* alarm) {
+    memset(alarm, 0, sizeof(OSAlarm));
+}
+
+void OSCancelAlarm(OSAlarm* alarm) {
+    OSAlarm** link;
+
+    for (link = &Alarms; *link != NULL; link = &(*link)->next) {
+        if (*link == alarm) {
+            *link = alarm->next;
+            break;
+        }
+    }
+    alarm->handler = NULL;
+    alarm->next = NULL;
+}
+
+void OSSetAlarm(OSAlarm* alarm, OSTime tick, OSAlarmHandler handler) {
+    OSAlarm** link;
+
+    if (alarm->handler != NULL) {
+        printf("OSSetAlarm: alarm %p is already set\n", (void*)alarm);
+        exit(1);
+    }
+
+    alarm->handler = handler;
+    alarm->fire = Now + tick;
+    for (link = &Alarms; *link != NULL && (*link)->fire <= alarm->fire; link = &(*link)->next) {
+        ;
+    }
+    alarm->next = *link;
+    *link = alarm;
+}
+
+void TestSetTime(OSTime time) {
+    Now = time;
+}
+
+void TestAdvance(OSTime ticks) {
+    OSTime end;
+    OSAlarm* alarm;
+    OSAlarmHandler handler;
+
+    end = Now + ticks;
+    while (Alarms != NULL && Alarms->fire <= end) {
+        alarm = Alarms;
+        Alarms = alarm->next;
+        handler = alarm->handler;
+        alarm->handler = NULL;
+        alarm->next = NULL;
+        if (Now < alarm->fire) {
+            Now = alarm->fire;
+        }
+        Fires++;
+        handler(alarm, NULL);
+    }
+    Now = end;
+}
+
+/* Number of alarm handlers run so far */
+int TestAlarmFires(void) {
+    return Fires;
+}
+
+int TestPendingAlarms(void) {
+    OSAlarm* alarm;
+    int n;
+
+    n = 0;
+    for (alarm = Alarms; alarm != NULL; alarm = alarm->next) {
+        n++;
+    }
+    return n;
+}
@@ -0,0 +1,16 @@
+#ifndef __TEST_IP_TEST_H__
+#define __TEST_IP_TEST_H__
+
+#include <dolphin/os.h>
+
+#define CHECK(cond) TestCheck((cond) ? TRUE : FALSE, __FILE__, __LINE__, #cond)
+
+void TestCheck(BOOL ok, const char* file, int line, const char* cond);
+int TestReport(const char* name);
+
+void TestSetTime(OSTime time);
+void TestAdvance(OSTime ticks);
+int TestPendingAlarms(void);
+int TestAlarmFires(void);
+
+#endif
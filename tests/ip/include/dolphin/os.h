@@ -0,0 +1,65 @@
+#ifndef __TEST_DOLPHIN_OS_H__
+#define __TEST_DOLPHIN_OS_H__
+
+/* Host stand-in for the SDK's <dolphin/os.h>. Time only moves when a test
+ * calls TestAdvance (see OSStub.c), which also fires the alarms that fall
+ * due on the way. */
+
+#include <dolphin/types.h>
+
+typedef s64 OSTime;
+typedef u32 OSTick;
+
+typedef struct OSContext OSContext;
+typedef struct OSAlarm OSAlarm;
+typedef void (*OSAlarmHandler)(OSAlarm* alarm, OSContext* context);
+
+struct OSAlarm {
+    OSAlarmHandler handler;
+    u32 tag;
+    OSTime fire;
+    OSAlarm* prev;
+    OSAlarm* next;
+    OSTime period;
+    OSTime start;
+};
+
+typedef struct OSThread OSThread;
+
+typedef struct OSThreadQueue {
+    OSThread* head;
+    OSThread* tail;
+} OSThreadQueue;
+
+typedef struct OSMutex {
+    OSThreadQueue queue;
+    OSThread* thread;
+    s32 count;
+    void* link[2];
+} OSMutex;
+
+#define OS_BUS_CLOCK 162000000u
+#define OS_CORE_CLOCK 486000000u
+#define OS_TIMER_CLOCK (OS_BUS_CLOCK / 4)
+
+#define OSSecondsToTicks(sec) ((sec) * (OS_TIMER_CLOCK))
+#define OSMillisecondsToTicks(msec) ((msec) * (OS_TIMER_CLOCK / 1000))
+#define OSMicrosecondsToTicks(usec) (((usec) * (OS_TIMER_CLOCK / 125000)) / 8)
+#define OSTicksToSeconds(ticks) ((ticks) / (OS_TIMER_CLOCK))
+#define OSTicksToMilliseconds(ticks) ((ticks) / (OS_TIMER_CLOCK / 1000))
+
+OSTime OSGetTime(void);
+OSTick OSGetTick(void);
+void OSCreateAlarm(OSAlarm* alarm);
+void OSSetAlarm(OSAlarm* alarm, OSTime tick, OSAlarmHandler handler);
+void OSCancelAlarm(OSAlarm* alarm);
+BOOL OSDisableInterrupts(void);
+BOOL OSRestoreInterrupts(BOOL level);
+void OSReport(const char* msg, ...);
+
+void __TestAssert(const char* file, int line, const char* cond);
+
+#define ASSERTLINE(line, cond) ((cond) ? (void)0 : __TestAssert(__FILE__, line, #cond))
+#define ASSERTMSGLINE(line, cond, ...) ASSERTLINE(line, cond)
+
+#endif
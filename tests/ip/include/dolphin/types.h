@@ -0,0 +1,38 @@
+#ifndef __TEST_DOLPHIN_TYPES_H__
+#define __TEST_DOLPHIN_TYPES_H__
+
+/* Host stand-in for the SDK's <dolphin/types.h>, enough to build the IP
+ * sources under test with the host compiler */
+
+#include <stddef.h>
+#include <string.h>
+
+typedef signed char s8;
+typedef signed short s16;
+typedef signed int s32;
+typedef signed long long s64;
+typedef unsigned char u8;
+typedef unsigned short u16;
+typedef unsigned int u32;
+typedef unsigned long long u64;
+
+typedef volatile u8 vu8;
+typedef volatile u16 vu16;
+typedef volatile u32 vu32;
+typedef volatile s32 vs32;
+
+typedef float f32;
+typedef double f64;
+
+typedef int BOOL;
+
+#define TRUE 1
+#define FALSE 0
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+#define ATTRIBUTE_ALIGN(num) __attribute__((aligned(num)))
+
+#endif